@@ -0,0 +1,103 @@
+/* File:     accum.h
+ * Purpose:  Contention-free accumulation of per-thread partial sums.
+ *
+ *           Each thread adds into its own slot, and every slot sits on
+ *           a cache line of its own, so threads neither wait on a lock
+ *           nor invalidate each other's caches.  Accum_add is cheap
+ *           enough to call inside a hot loop.  When the threads are
+ *           done, Accum_combine adds the slots by a fixed pairwise tree.
+ *
+ * Usage:    accum_t acc;
+ *           Accum_init(&acc, thread_count);
+ *           ... in thread my_rank:  Accum_add(&acc, my_rank, x);
+ *           ... after the threads have joined:
+ *           total = Accum_combine(&acc);
+ *           Accum_free(&acc);
+ *
+ * Note:     A slot must only be written by one thread at a time, and
+ *           Accum_combine must not run concurrently with Accum_add
+ *           (call it after a join or barrier).
+ */
+#ifndef ACCUM_H
+#define ACCUM_H
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#define CACHE_LINE 64
+
+typedef struct {
+   double value;
+   char   pad[CACHE_LINE - sizeof(double)];
+} accum_slot_t;
+
+typedef struct {
+   accum_slot_t* slots;       /* CACHE_LINE aligned      */
+   int           slot_count;
+   void*         block;       /* what malloc returned    */
+} accum_t;
+
+/*------------------------------------------------------------------
+ * Function:    Accum_reset
+ * Purpose:     Set every slot to 0
+ */
+static inline void Accum_reset(accum_t* acc_p) {
+   int i;
+
+   for (i = 0; i < acc_p->slot_count; i++)
+      acc_p->slots[i].value = 0.0;
+}  /* Accum_reset */
+
+/*------------------------------------------------------------------
+ * Function:    Accum_init
+ * Purpose:     Allocate slot_count zeroed, cache line aligned slots
+ */
+static inline void Accum_init(accum_t* acc_p, int slot_count) {
+   uintptr_t addr;
+
+   acc_p->block = malloc((slot_count + 1)*sizeof(accum_slot_t));
+   addr = (uintptr_t) acc_p->block;
+   addr = (addr + CACHE_LINE - 1) & ~(uintptr_t) (CACHE_LINE - 1);
+   acc_p->slots = (accum_slot_t*) addr;
+   acc_p->slot_count = slot_count;
+   Accum_reset(acc_p);
+}  /* Accum_init */
+
+/*------------------------------------------------------------------
+ * Function:    Accum_free
+ */
+static inline void Accum_free(accum_t* acc_p) {
+   free(acc_p->block);
+   acc_p->block = NULL;
+   acc_p->slots = NULL;
+}  /* Accum_free */
+
+/*------------------------------------------------------------------
+ * Function:    Accum_add
+ * Purpose:     Add x to slot (normally the caller's thread rank)
+ */
+static inline void Accum_add(accum_t* acc_p, int slot, double x) {
+   acc_p->slots[slot].value += x;
+}  /* Accum_add */
+
+/*------------------------------------------------------------------
+ * Function:    Accum_combine_range / Accum_combine
+ * Purpose:     Add the slots first <= i < last (all the slots) by a
+ *              fixed pairwise tree
+ */
+static inline double Accum_combine_range(const accum_t* acc_p, int first,
+      int last) {
+   int mid;
+
+   if (last - first <= 0) return 0.0;
+   if (last - first == 1) return acc_p->slots[first].value;
+   mid = first + (last - first)/2;
+   return Accum_combine_range(acc_p, first, mid)
+        + Accum_combine_range(acc_p, mid, last);
+}  /* Accum_combine_range */
+
+static inline double Accum_combine(const accum_t* acc_p) {
+   return Accum_combine_range(acc_p, 0, acc_p->slot_count);
+}  /* Accum_combine */
+
+#endif
@@ -0,0 +1,202 @@
+/* File:     adapt.h
+ * Purpose:  Adaptive Simpson quadrature building blocks shared by
+ *           the trapezoidal rule programs: the task describing one
+ *           subinterval, the refinement step, and a double-ended
+ *           queue of tasks.
+ *
+ *           A task that fails its error test is split in two.  The
+ *           thread keeps working on one half and pushes the other on
+ *           the bottom of its own deque.  An idle thread steals from
+ *           the top of someone else's deque, where the oldest, and so
+ *           the largest, subintervals are.
+ *
+ * Notes:
+ * 1.  The deque does no locking.  Each program guards it with its own
+ *     lock type (omp_lock_t, pthread_mutex_t).
+ * 2.  The error test is the usual |S(l)+S(r) - S(whole)| <= 15*tol,
+ *     and an accepted task returns the Richardson extrapolated
+ *     S(l)+S(r) + (S(l)+S(r) - S(whole))/15.
+ */
+#ifndef ADAPT_H
+#define ADAPT_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "integrands.h"
+
+/* Give up refining a subinterval after this many halvings */
+#define ADAPT_MAX_DEPTH 50
+
+typedef struct {
+   double a, m, b;       /* endpoints and midpoint           */
+   double fa, fm, fb;    /* f at a, m and b                  */
+   double whole;         /* Simpson estimate over [a, b]     */
+   double tol;           /* error allowed on [a, b]          */
+   int    depth;
+} adapt_task_t;
+
+typedef struct {
+   adapt_task_t* tasks;
+   int top;              /* oldest task, taken by thieves    */
+   int bottom;           /* one past the newest task         */
+   int capacity;
+} adapt_deque_t;
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_make_task
+ * Purpose:     Build the task for [a, b] given f at the endpoints
+ * Return val:  The number of evaluations of f done (1)
+ */
+static inline int Adapt_make_task(const integrand_t* integrand,
+      double a, double fa, double b, double fb, double tol, int depth,
+      adapt_task_t* task_p) {
+   task_p->a = a;
+   task_p->b = b;
+   task_p->m = (a + b)/2.0;
+   task_p->fa = fa;
+   task_p->fb = fb;
+   task_p->fm = integrand->f(task_p->m);
+   task_p->whole = (b - a)*(fa + 4.0*task_p->fm + fb)/6.0;
+   task_p->tol = tol;
+   task_p->depth = depth;
+   return 1;
+}  /* Adapt_make_task */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_step
+ * Purpose:     Refine a task once
+ * In args:     integrand, task_p
+ * Out args:    result_p:  the estimate for the task, if it's accepted
+ *              left_p, right_p:  the two halves, if it isn't
+ *              evals_p:   incremented by the evaluations of f done
+ * Return val:  1 if the task is accepted, 0 if it was split
+ */
+static inline int Adapt_step(const integrand_t* integrand,
+      const adapt_task_t* task_p, double* result_p,
+      adapt_task_t* left_p, adapt_task_t* right_p, long* evals_p) {
+   double diff;
+
+   *evals_p += Adapt_make_task(integrand, task_p->a, task_p->fa,
+         task_p->m, task_p->fm, task_p->tol/2.0, task_p->depth+1, left_p);
+   *evals_p += Adapt_make_task(integrand, task_p->m, task_p->fm,
+         task_p->b, task_p->fb, task_p->tol/2.0, task_p->depth+1, right_p);
+
+   diff = left_p->whole + right_p->whole - task_p->whole;
+   if (fabs(diff) <= 15.0*task_p->tol || task_p->depth >= ADAPT_MAX_DEPTH
+         || left_p->m <= task_p->a || right_p->m >= task_p->b) {
+      *result_p = left_p->whole + right_p->whole + diff/15.0;
+      return 1;
+   }
+   return 0;
+}  /* Adapt_step */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_run
+ * Purpose:     Refine a task depth first, keeping the left half of
+ *              every split and handing the right half to push
+ * In args:     integrand, task
+ *              push:   called with a task to share, and ctx
+ * Out args:    evals_p:  incremented by the evaluations of f done
+ * Return val:  The estimate over the leftmost accepted subinterval
+ * Note:        push must copy the task.
+ */
+static inline double Adapt_run(const integrand_t* integrand,
+      adapt_task_t task, void (*push)(void* ctx, const adapt_task_t*),
+      void* ctx, long* evals_p) {
+   adapt_task_t left, right;
+   double result;
+
+   while (!Adapt_step(integrand, &task, &result, &left, &right, evals_p)) {
+      push(ctx, &right);
+      task = left;
+   }
+   return result;
+}  /* Adapt_run */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_deque_init / Adapt_deque_free
+ */
+static inline void Adapt_deque_init(adapt_deque_t* dq_p) {
+   dq_p->capacity = 2*ADAPT_MAX_DEPTH;
+   dq_p->tasks = (adapt_task_t*) malloc(dq_p->capacity*sizeof(adapt_task_t));
+   dq_p->top = dq_p->bottom = 0;
+}  /* Adapt_deque_init */
+
+static inline void Adapt_deque_free(adapt_deque_t* dq_p) {
+   free(dq_p->tasks);
+   dq_p->tasks = NULL;
+}  /* Adapt_deque_free */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_deque_size
+ */
+static inline int Adapt_deque_size(const adapt_deque_t* dq_p) {
+   return dq_p->bottom - dq_p->top;
+}  /* Adapt_deque_size */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_deque_push
+ * Purpose:     Add a task at the bottom, growing the deque if needed
+ */
+static inline void Adapt_deque_push(adapt_deque_t* dq_p,
+      const adapt_task_t* task_p) {
+   if (dq_p->bottom == dq_p->capacity) {
+      if (dq_p->top > 0) {
+         memmove(dq_p->tasks, dq_p->tasks + dq_p->top,
+               Adapt_deque_size(dq_p)*sizeof(adapt_task_t));
+         dq_p->bottom -= dq_p->top;
+         dq_p->top = 0;
+      } else {
+         dq_p->capacity *= 2;
+         dq_p->tasks = (adapt_task_t*) realloc(dq_p->tasks,
+               dq_p->capacity*sizeof(adapt_task_t));
+      }
+   }
+   dq_p->tasks[dq_p->bottom++] = *task_p;
+}  /* Adapt_deque_push */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_deque_pop
+ * Purpose:     Owner's end: take the newest task
+ * Return val:  1 if a task was taken, 0 if the deque is empty
+ */
+static inline int Adapt_deque_pop(adapt_deque_t* dq_p,
+      adapt_task_t* task_p) {
+   if (dq_p->bottom == dq_p->top) return 0;
+   *task_p = dq_p->tasks[--dq_p->bottom];
+   if (dq_p->bottom == dq_p->top) dq_p->top = dq_p->bottom = 0;
+   return 1;
+}  /* Adapt_deque_pop */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_deque_steal
+ * Purpose:     Thief's end: take the oldest task
+ * Return val:  1 if a task was taken, 0 if the deque is empty
+ */
+static inline int Adapt_deque_steal(adapt_deque_t* dq_p,
+      adapt_task_t* task_p) {
+   if (dq_p->bottom == dq_p->top) return 0;
+   *task_p = dq_p->tasks[dq_p->top++];
+   if (dq_p->bottom == dq_p->top) dq_p->top = dq_p->bottom = 0;
+   return 1;
+}  /* Adapt_deque_steal */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_first_task
+ * Purpose:     Build the task for panel i of n equal panels of [a, b]
+ *              with a share of tol proportional to its width
+ * Out args:    task_p, evals_p (incremented)
+ */
+static inline void Adapt_first_task(const integrand_t* integrand,
+      double a, double b, int n, int i, double tol,
+      adapt_task_t* task_p, long* evals_p) {
+   double h = (b - a)/n;
+   double left = a + i*h;
+   double right = (i == n-1) ? b : a + (i+1)*h;
+
+   *evals_p += 2 + Adapt_make_task(integrand, left, integrand->f(left),
+         right, integrand->f(right), tol/n, 0, task_p);
+}  /* Adapt_first_task */
+
+#endif
@@ -0,0 +1,106 @@
+/* File:     batch.h
+ * Purpose:  Batch mode of the trapezoidal rule programs: read a file
+ *           of integrals and compute all of them in one run.
+ *
+ * Input:    A text file with one job per line
+ *
+ *              <integrand name> <a> <b> <n>
+ *
+ *           Blank lines and lines starting with '#' are skipped.
+ * Output:   One line per job, in the order of the file.
+ *
+ * Note:     Each job is computed by a single thread or process with
+ *           the serial trapezoidal rule; the programs spread the jobs
+ *           over their threads or processes.
+ */
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "integrands.h"
+
+typedef struct {
+   int    integrand;    /* index in integrands[] */
+   double a, b;
+   int    n;
+} batch_job_t;
+
+/*------------------------------------------------------------------
+ * Function:    Read_batch
+ * Purpose:     Read the jobs in a batch file
+ * Input args:  fname
+ * Output args: jobs_pp:   newly allocated array of jobs
+ *              count_p:   number of jobs
+ * Return val:  0 on success, -1 (after printing a message) if the file
+ *              can't be read or a line is bad
+ */
+static inline int Read_batch(const char* fname, batch_job_t** jobs_pp,
+      int* count_p) {
+   FILE* fp;
+   char line[256], name[64];
+   int capacity = 64, line_no = 0;
+   const integrand_t* integrand;
+   batch_job_t job;
+
+   fp = fopen(fname, "r");
+   if (fp == NULL) {
+      fprintf(stderr, "Can't open batch file %s\n", fname);
+      return -1;
+   }
+
+   *count_p = 0;
+   *jobs_pp = (batch_job_t*) malloc(capacity*sizeof(batch_job_t));
+   while (fgets(line, sizeof(line), fp) != NULL) {
+      line_no++;
+      if (sscanf(line, " %63s", name) != 1 || name[0] == '#')
+         continue;
+      if (sscanf(line, "%63s %lf %lf %d", name, &job.a, &job.b,
+               &job.n) != 4 || job.n < 1
+            || (integrand = Find_integrand(name)) == NULL) {
+         fprintf(stderr, "%s:%d: bad job: %s", fname, line_no, line);
+         fclose(fp);
+         free(*jobs_pp);
+         return -1;
+      }
+      job.integrand = (int) (integrand - integrands);
+      if (*count_p == capacity) {
+         capacity *= 2;
+         *jobs_pp = (batch_job_t*) realloc(*jobs_pp,
+               capacity*sizeof(batch_job_t));
+      }
+      (*jobs_pp)[(*count_p)++] = job;
+   }
+
+   fclose(fp);
+   return 0;
+}  /* Read_batch */
+
+/*------------------------------------------------------------------
+ * Function:    Batch_trap
+ * Purpose:     Serial trapezoidal rule for one job
+ */
+static inline double Batch_trap(const batch_job_t* job_p) {
+   const integrand_t* integrand = &integrands[job_p->integrand];
+   double h = (job_p->b - job_p->a)/job_p->n;
+   double estimate;
+
+   estimate = (integrand->f(job_p->a) + integrand->f(job_p->b))/2.0;
+   estimate += integrand->sum(job_p->a, h, 1, job_p->n - 1);
+   return estimate*h;
+}  /* Batch_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Print_batch
+ * Purpose:     Print the jobs and their results in file order
+ */
+static inline void Print_batch(const batch_job_t jobs[],
+      const double results[], int count) {
+   int i;
+
+   for (i = 0; i < count; i++)
+      printf("%-10s %f %f %d %.15e\n", integrands[jobs[i].integrand].name,
+            jobs[i].a, jobs[i].b, jobs[i].n, results[i]);
+}  /* Print_batch */
+
+#endif
@@ -0,0 +1,451 @@
+/* File:     cache.h
+ * Purpose:  Persistent cache of integrals for -cache <file>, so that
+ *           integrating the same integrand over the same or an
+ *           overlapping interval again costs little more than reading
+ *           the cache.
+ *
+ *           Two kinds of entries are kept:
+ *
+ *           - Results, keyed by (integrand, rule, a, b, n), for exact
+ *             repeats.
+ *           - Block sums on a lattice.  The abscissas of the trapezoid
+ *             rule with width h are a + k*h.  Writing a as
+ *             (i0 + t)*h with i0 an integer and 0 <= t < 1, they are
+ *             (i + t)*h, i = i0, i0+1, ...  So for every interval
+ *             with the same h and t they lie on one lattice anchored
+ *             at 0.  The lattice is cut into blocks of CACHE_BLOCK
+ *             points, and the sum of f over each block is cached,
+ *             keyed by (integrand, h, t, block).  A new interval is
+ *             then the cached blocks it covers, plus the blocks it
+ *             needs that aren't cached yet (computed in parallel),
+ *             plus the partial blocks at its two ends.
+ *             Each node of a -rule panel is such a lattice too, with
+ *             its own t.
+ *
+ *           Intervals further than 2^50 points from 0 are anchored at a
+ *           instead of 0, so their blocks are only shared with
+ *           intervals that start at the same a.
+ *
+ * File:     Binary records (64-bit key, value) appended at the end of
+ *           each run; keys are 64-bit FNV-1a hashes of the key fields.
+ *           The file is read whole at startup.  It isn't locked, so
+ *           runs sharing a cache file shouldn't finish at the same
+ *           time.
+ *
+ * Usage:    Cache_open, then Cache_plan.  If that finds no result,
+ *           compute the missing blocks with Cache_fill (split among
+ *           the threads or processes) and call Cache_finish.  Then
+ *           Cache_plan_free and Cache_close.
+ */
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdint.h>
+#include "integrands.h"
+#include "rules.h"
+
+#define CACHE_BLOCK  (1 << 16)   /* Lattice points per cached block   */
+#define CACHE_ANCHOR 1125899906842624.0   /* 2^50                      */
+
+typedef struct {
+   uint64_t key;   /* 0: empty slot */
+   double   value;
+} cache_rec_t;
+
+typedef struct {
+   const char*  fname;
+   cache_rec_t* slots;      /* open addressing, capacity a power of 2 */
+   size_t       capacity;
+   size_t       count;
+   cache_rec_t* fresh;      /* entries to append to the file          */
+   size_t       fresh_count;
+   size_t       fresh_capacity;
+} cache_t;
+
+/* Points (anchor + (i + t)*h), first <= i <= last, with weight */
+typedef struct {
+   double    t, weight;
+   long long first, last;
+   long long block0;        /* whole blocks block0, ..., block0+blocks-1 */
+   int       blocks;
+} cache_class_t;
+
+typedef struct {
+   const integrand_t* integrand;
+   const quad_rule_t* rule;        /* NULL: trapezoids              */
+   double        a, b, h, anchor;
+   int           n;
+   double        end_weight;       /* weight of f(a) + f(b)         */
+   int           class_count;
+   cache_class_t classes[RULE_MAX_NODES + 1];
+   int           block_count;      /* blocks of all the classes     */
+   uint64_t*     keys;
+   double*       values;
+   int*          missing;          /* blocks that weren't cached    */
+   int           missing_count;
+   uint64_t      result_key;
+   int           hit;              /* result was cached             */
+   double        result;
+} cache_plan_t;
+
+/*------------------------------------------------------------------
+ * Function:    Cache_hash
+ * Purpose:     Add len bytes to a 64-bit FNV-1a hash
+ */
+static inline uint64_t Cache_hash(uint64_t hash, const void* data,
+      size_t len) {
+   const unsigned char* p = (const unsigned char*) data;
+   size_t i;
+
+   for (i = 0; i < len; i++) {
+      hash ^= p[i];
+      hash *= 1099511628211ULL;
+   }
+   return hash;
+}  /* Cache_hash */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_key_start
+ * Purpose:     Start a key with the kind of entry and the integrand
+ */
+static inline uint64_t Cache_key_start(char kind,
+      const integrand_t* integrand) {
+   uint64_t hash = 14695981039346656037ULL;
+
+   hash = Cache_hash(hash, &kind, 1);
+   hash = Cache_hash(hash, integrand->name, strlen(integrand->name) + 1);
+   return Cache_hash(hash, integrand->formula,
+         strlen(integrand->formula) + 1);
+}  /* Cache_key_start */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_insert
+ * Purpose:     Add or replace an entry in the table
+ */
+static inline void Cache_insert(cache_t* c_p, uint64_t key, double value) {
+   cache_rec_t* old;
+   size_t i, old_capacity;
+
+   if (key == 0) key = 1;
+   if (2*(c_p->count + 1) > c_p->capacity) {
+      old = c_p->slots;
+      old_capacity = c_p->capacity;
+      c_p->capacity = old_capacity ? 2*old_capacity : 1024;
+      c_p->slots = (cache_rec_t*) calloc(c_p->capacity, sizeof(cache_rec_t));
+      c_p->count = 0;
+      for (i = 0; i < old_capacity; i++)
+         if (old[i].key != 0)
+            Cache_insert(c_p, old[i].key, old[i].value);
+      free(old);
+   }
+   i = (size_t) key & (c_p->capacity - 1);
+   while (c_p->slots[i].key != 0 && c_p->slots[i].key != key)
+      i = (i + 1) & (c_p->capacity - 1);
+   if (c_p->slots[i].key == 0) c_p->count++;
+   c_p->slots[i].key = key;
+   c_p->slots[i].value = value;
+}  /* Cache_insert */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_get
+ * Return val:  1 and the value in *value_p if key is cached, else 0
+ */
+static inline int Cache_get(const cache_t* c_p, uint64_t key,
+      double* value_p) {
+   size_t i;
+
+   if (c_p == NULL || c_p->capacity == 0) return 0;
+   if (key == 0) key = 1;
+   i = (size_t) key & (c_p->capacity - 1);
+   while (c_p->slots[i].key != 0) {
+      if (c_p->slots[i].key == key) {
+         *value_p = c_p->slots[i].value;
+         return 1;
+      }
+      i = (i + 1) & (c_p->capacity - 1);
+   }
+   return 0;
+}  /* Cache_get */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_put
+ * Purpose:     Add an entry, and remember to write it to the file
+ */
+static inline void Cache_put(cache_t* c_p, uint64_t key, double value) {
+   Cache_insert(c_p, key, value);
+   if (c_p->fresh_count == c_p->fresh_capacity) {
+      c_p->fresh_capacity = c_p->fresh_capacity ? 2*c_p->fresh_capacity
+                                                : 256;
+      c_p->fresh = (cache_rec_t*) realloc(c_p->fresh,
+            c_p->fresh_capacity*sizeof(cache_rec_t));
+   }
+   c_p->fresh[c_p->fresh_count].key = key;
+   c_p->fresh[c_p->fresh_count].value = value;
+   c_p->fresh_count++;
+}  /* Cache_put */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_open
+ * Purpose:     Read the entries in fname, if it exists
+ * Return val:  0 on success, -1 (after printing a message) if fname
+ *              exists but can't be read
+ */
+static inline int Cache_open(cache_t* c_p, const char* fname) {
+   FILE* fp;
+   cache_rec_t rec;
+
+   memset(c_p, 0, sizeof(*c_p));
+   c_p->fname = fname;
+   fp = fopen(fname, "rb");
+   if (fp == NULL) return 0;   /* A new cache */
+   while (fread(&rec, sizeof(rec), 1, fp) == 1)
+      Cache_insert(c_p, rec.key, rec.value);
+   if (ferror(fp)) {
+      fprintf(stderr, "Can't read cache %s\n", fname);
+      fclose(fp);
+      return -1;
+   }
+   fclose(fp);
+   return 0;
+}  /* Cache_open */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_close
+ * Purpose:     Append the new entries to the file and free the table
+ * Return val:  0 on success, -1 (after printing a message) if the
+ *              file can't be written
+ */
+static inline int Cache_close(cache_t* c_p) {
+   FILE* fp;
+   int error = 0;
+
+   if (c_p->fresh_count > 0) {
+      fp = fopen(c_p->fname, "ab");
+      error = fp == NULL
+         || fwrite(c_p->fresh, sizeof(cache_rec_t), c_p->fresh_count, fp)
+               != c_p->fresh_count;
+      if (fp != NULL) error |= fclose(fp) != 0;
+      if (error) fprintf(stderr, "Can't write cache %s\n", c_p->fname);
+   }
+   free(c_p->slots);
+   free(c_p->fresh);
+   return error ? -1 : 0;
+}  /* Cache_close */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_add_class
+ * Purpose:     Add the points (anchor + (i + t)*h), first <= i <= last,
+ *              with weight to the plan, and find the whole blocks
+ *              among them
+ */
+static inline void Cache_add_class(cache_plan_t* p_p, double t,
+      double weight, long long first, long long last) {
+   cache_class_t* c = &p_p->classes[p_p->class_count++];
+   long long end;
+
+   c->t = t;
+   c->weight = weight;
+   c->first = first;
+   c->last = last;
+   /* First whole block at or after first, and the end of the last
+    * whole block at or before last+1 (floor division for i < 0) */
+   c->block0 = first >= 0 ? (first + CACHE_BLOCK - 1)/CACHE_BLOCK
+                          : -((-first)/CACHE_BLOCK);
+   end = last + 1 >= 0 ? (last + 1)/CACHE_BLOCK
+                       : -((-(last + 1) + CACHE_BLOCK - 1)/CACHE_BLOCK);
+   c->blocks = end > c->block0 ? (int) (end - c->block0) : 0;
+   p_p->block_count += c->blocks;
+}  /* Cache_add_class */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_block
+ * Purpose:     Find the class and lattice block of block g of the plan
+ */
+static inline const cache_class_t* Cache_block(const cache_plan_t* p_p,
+      int g, long long* block_p) {
+   int c = 0;
+
+   while (g >= p_p->classes[c].blocks) {
+      g -= p_p->classes[c].blocks;
+      c++;
+   }
+   *block_p = p_p->classes[c].block0 + g;
+   return &p_p->classes[c];
+}  /* Cache_block */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_plan
+ * Purpose:     Plan the integral of integrand from a to b by rule (or
+ *              trapezoids) with n panels, and look it up in the cache
+ * Input args:  c_p:  the cache, or NULL to plan without looking up
+ *                    (all the blocks are then missing)
+ * Output args: p_p:  if p_p->hit the result is p_p->result; else
+ *                    p_p->missing lists the blocks to Cache_fill
+ */
+static inline void Cache_plan(cache_plan_t* p_p, const cache_t* c_p,
+      const integrand_t* integrand, const quad_rule_t* rule, double a,
+      double b, int n) {
+   double h = (b - a)/n, pos, t;
+   long long i0, block;
+   const cache_class_t* c;
+   uint64_t key;
+   int g, j;
+
+   memset(p_p, 0, sizeof(*p_p));
+   p_p->integrand = integrand;
+   p_p->rule = rule;
+   p_p->a = a;
+   p_p->b = b;
+   p_p->h = h;
+   p_p->n = n;
+
+   key = Cache_key_start('r', integrand);
+   key = Cache_hash(key, rule != NULL ? rule->name : "trap",
+         rule != NULL ? strlen(rule->name) + 1 : 5);
+   key = Cache_hash(key, &a, sizeof(a));
+   key = Cache_hash(key, &b, sizeof(b));
+   key = Cache_hash(key, &n, sizeof(n));
+   p_p->result_key = key;
+   p_p->hit = Cache_get(c_p, key, &p_p->result);
+   if (p_p->hit) return;
+
+   /* a = anchor + (i0 + t)*h */
+   pos = a/h;
+   if (fabs(pos) + n < CACHE_ANCHOR) {
+      p_p->anchor = 0.0;
+      i0 = (long long) floor(pos);
+      t = pos - (double) i0;
+   } else {
+      p_p->anchor = a;
+      i0 = 0;
+      t = 0.0;
+   }
+
+   if (rule == NULL) {
+      p_p->end_weight = 0.5;
+      Cache_add_class(p_p, t, 1.0, i0 + 1, i0 + n - 1);
+   } else {
+      p_p->end_weight = rule->end_weight;
+      if (rule->end_weight != 0.0)
+         Cache_add_class(p_p, t, 2.0*rule->end_weight, i0 + 1, i0 + n - 1);
+      for (j = 0; j < rule->nodes; j++)
+         Cache_add_class(p_p, t + rule->t[j], rule->w[j], i0, i0 + n - 1);
+   }
+
+   p_p->keys = (uint64_t*) malloc(p_p->block_count*sizeof(uint64_t));
+   p_p->values = (double*) malloc(p_p->block_count*sizeof(double));
+   p_p->missing = (int*) malloc(p_p->block_count*sizeof(int));
+   for (g = 0; g < p_p->block_count; g++) {
+      c = Cache_block(p_p, g, &block);
+      key = Cache_key_start('b', integrand);
+      key = Cache_hash(key, &p_p->anchor, sizeof(double));
+      key = Cache_hash(key, &h, sizeof(h));
+      key = Cache_hash(key, &c->t, sizeof(c->t));
+      key = Cache_hash(key, &block, sizeof(block));
+      p_p->keys[g] = key;
+      if (!Cache_get(c_p, key, &p_p->values[g]))
+         p_p->missing[p_p->missing_count++] = g;
+   }
+}  /* Cache_plan */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_points
+ * Purpose:     Sum of f at the points first <= i <= last of a class,
+ *              in the order of the lattice (so a block is always
+ *              summed the same way)
+ */
+static inline double Cache_points(const cache_plan_t* p_p,
+      const cache_class_t* c, long long first, long long last) {
+   if (last < first) return 0.0;
+   return p_p->integrand->sum(p_p->anchor + (first + c->t)*p_p->h, p_p->h,
+         0, (int) (last - first));
+}  /* Cache_points */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_fill
+ * Purpose:     Compute the missing blocks p_p->missing[k],
+ *              first <= k < last
+ */
+static inline void Cache_fill(cache_plan_t* p_p, int first, int last) {
+   const cache_class_t* c;
+   long long block;
+   int k, g;
+
+   for (k = first; k < last; k++) {
+      g = p_p->missing[k];
+      c = Cache_block(p_p, g, &block);
+      p_p->values[g] = Cache_points(p_p, c, block*CACHE_BLOCK,
+            block*CACHE_BLOCK + CACHE_BLOCK - 1);
+   }
+}  /* Cache_fill */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_finish
+ * Purpose:     Put the missing blocks in the cache, and add up the
+ *              blocks, the partial blocks at the ends and f(a), f(b)
+ *              into the result, which is also cached
+ * Return val:  The integral
+ */
+static inline double Cache_finish(cache_plan_t* p_p, cache_t* c_p) {
+   const integrand_t* integrand = p_p->integrand;
+   const cache_class_t* c;
+   double total, class_sum;
+   long long end;
+   int k, g = 0, j;
+
+   for (k = 0; k < p_p->missing_count; k++)
+      Cache_put(c_p, p_p->keys[p_p->missing[k]],
+            p_p->values[p_p->missing[k]]);
+
+   total = p_p->end_weight*(integrand->f(p_p->a) + integrand->f(p_p->b));
+   for (j = 0; j < p_p->class_count; j++) {
+      c = &p_p->classes[j];
+      if (c->blocks == 0) {
+         class_sum = Cache_points(p_p, c, c->first, c->last);
+      } else {
+         end = (c->block0 + c->blocks)*CACHE_BLOCK;
+         class_sum = Cache_points(p_p, c, c->first,
+               c->block0*CACHE_BLOCK - 1);
+         for (k = 0; k < c->blocks; k++)
+            class_sum += p_p->values[g++];
+         class_sum += Cache_points(p_p, c, end, c->last);
+      }
+      total += c->weight*class_sum;
+   }
+
+   p_p->result = total*p_p->h;
+   Cache_put(c_p, p_p->result_key, p_p->result);
+   return p_p->result;
+}  /* Cache_finish */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_plan_free
+ */
+static inline void Cache_plan_free(cache_plan_t* p_p) {
+   free(p_p->keys);
+   free(p_p->values);
+   free(p_p->missing);
+}  /* Cache_plan_free */
+
+/*------------------------------------------------------------------
+ * Function:    Print_cache_result
+ */
+static inline void Print_cache_result(const cache_plan_t* p_p) {
+   if (p_p->rule != NULL)
+      printf("With n = %d %s panels", p_p->n, p_p->rule->name);
+   else
+      printf("With n = %d trapezoids", p_p->n);
+   if (p_p->hit)
+      printf(" (result from the cache), our estimate\n");
+   else
+      printf(" (%d of %d blocks from the cache), our estimate\n",
+            p_p->block_count - p_p->missing_count, p_p->block_count);
+   printf("of the integral of %s from %f to %f = %.15e\n",
+         p_p->integrand->formula, p_p->a, p_p->b, p_p->result);
+}  /* Print_cache_result */
+
+#endif
@@ -0,0 +1,265 @@
+/* File:     cubature.h
+ * Purpose:  Tensor-product trapezoidal rule over 2D and 3D boxes,
+ *           shared by the trapezoidal rule programs.
+ *
+ *           The box [a0,b0] x [a1,b1] (x [a2,b2]) is cut into n[d]
+ *           intervals along each axis, and the grid of points is split
+ *           into tiles of CUB_TILE_X x CUB_TILE_Y x CUB_TILE_Z points.
+ *           The programs hand out tiles to threads or processes.  In a
+ *           tile every row along x is one call to a row kernel which,
+ *           like the 1D kernels of integrands.h, is compiled with f
+ *           inlined and TRAP_LANES independent partial sums, once per
+ *           ISA.
+ *
+ * Adding an integrand:
+ *    Add a line X(name, dims, "formula", expression in x, y, z) to
+ *    CUB_INTEGRAND_LIST.  2D integrands just ignore z.  As in
+ *    integrands.h, use the Vm_ functions of vmath.h rather than libm.
+ */
+#ifndef CUBATURE_H
+#define CUBATURE_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "trap_isa.h"
+#include "vmath.h"
+
+/* Tile shape, in grid points */
+#define CUB_TILE_X 256
+#define CUB_TILE_Y 32
+#define CUB_TILE_Z 8
+
+/* X(name, dims, formula, expression in x, y, z) */
+#define CUB_INTEGRAND_LIST(X) \
+   X(xy,       2, "x*y",                     x*y) \
+   X(gauss2,   2, "exp(-(x*x+y*y))",         Vm_exp(-(x*x + y*y))) \
+   X(ripple2,  2, "sin(x)*cos(y)+x*y*y",     Vm_sin(x)*Vm_cos(y) + x*y*y) \
+   X(xyz,      3, "x*y*z",                   x*y*z) \
+   X(gauss3,   3, "exp(-(x*x+y*y+z*z))",     Vm_exp(-(x*x + y*y + z*z))) \
+   X(inv_r3,   3, "1/(1+x*x+y*y+z*z)",       1.0/(1.0 + x*x + y*y + z*z))
+
+typedef double (*cub_fn)(double x, double y, double z);
+typedef double (*cub_row_fn)(double x0, double h, int first, int last,
+      double y, double z);
+
+typedef struct {
+   const char*  name;
+   int          dims;
+   const char*  formula;
+   cub_fn       f;
+   cub_row_fn   row;    /* sum of f(x0+i*h, y, z), first <= i <= last */
+   cub_row_fn   kernels[TRAP_ISA_COUNT];
+} cub_integrand_t;
+
+typedef struct {
+   int    dims;
+   double a[3], b[3], h[3];
+   int    n[3];        /* intervals along each axis (0 past dims) */
+   int    tiles[3];    /* tiles along each axis                    */
+} cub_grid_t;
+
+/*------------------------------------------------------------------
+ * Macro:       DEFINE_CUB_ROW
+ * Purpose:     Define a row kernel for fn(x, y, z), like DEFINE_TRAP_SUM
+ */
+#define DEFINE_CUB_ROW(kernel, target, fn)                           \
+   static target double kernel(double x0, double h, int first,       \
+         int last, double y, double z) {                             \
+      double acc[TRAP_LANES];                                        \
+      double sum = 0.0;                                              \
+      int i, l;                                                      \
+                                                                     \
+      for (l = 0; l < TRAP_LANES; l++)                               \
+         acc[l] = 0.0;                                               \
+      for (i = first; i <= last - (TRAP_LANES-1); i += TRAP_LANES)   \
+         for (l = 0; l < TRAP_LANES; l++)                            \
+            acc[l] += fn(x0 + (i+l)*h, y, z);                        \
+      for (; i <= last; i++)                                         \
+         sum += fn(x0 + i*h, y, z);                                  \
+      for (l = TRAP_LANES/2; l > 0; l /= 2)                          \
+         for (i = 0; i < l; i++)                                     \
+            acc[i] += acc[i+l];                                      \
+      return sum + acc[0];                                           \
+   }
+
+#if TRAP_HAVE_X86_KERNELS
+#define DEFINE_CUB_ISA_ROWS(name)                                    \
+   DEFINE_CUB_ROW(Row_##name##_avx2, TRAP_TARGET_AVX2, G_##name)     \
+   DEFINE_CUB_ROW(Row_##name##_avx512, TRAP_TARGET_AVX512, G_##name)
+#define CUB_ISA_ROWS(name) \
+   {Row_##name##_generic, Row_##name##_avx2, Row_##name##_avx512}
+#else
+#define DEFINE_CUB_ISA_ROWS(name)
+#define CUB_ISA_ROWS(name) \
+   {Row_##name##_generic, Row_##name##_generic, Row_##name##_generic}
+#endif
+
+#define DEFINE_CUB_INTEGRAND(name, dims, formula, expr)              \
+   static inline double G_##name(double x, double y, double z) {     \
+      (void) x; (void) y; (void) z;                                  \
+      return (expr);                                                 \
+   }                                                                 \
+   DEFINE_CUB_ROW(Row_##name##_generic, TRAP_TARGET_GENERIC, G_##name) \
+   DEFINE_CUB_ISA_ROWS(name)
+
+CUB_INTEGRAND_LIST(DEFINE_CUB_INTEGRAND)
+
+#define CUB_INTEGRAND_ENTRY(name, dims, formula, expr) \
+   {#name, dims, formula, G_##name, Row_##name##_generic, CUB_ISA_ROWS(name)},
+
+static cub_integrand_t cub_integrands[] = {
+   CUB_INTEGRAND_LIST(CUB_INTEGRAND_ENTRY)
+};
+
+#define CUB_INTEGRAND_COUNT \
+   ((int) (sizeof(cub_integrands)/sizeof(cub_integrands[0])))
+
+/*------------------------------------------------------------------
+ * Function:    Find_cub_integrand
+ * Return val:  The multi-dimensional integrand called name, or NULL
+ */
+static inline const cub_integrand_t* Find_cub_integrand(const char* name) {
+   int i;
+
+   for (i = 0; i < CUB_INTEGRAND_COUNT; i++)
+      if (strcmp(cub_integrands[i].name, name) == 0)
+         return &cub_integrands[i];
+   return NULL;
+}  /* Find_cub_integrand */
+
+/*------------------------------------------------------------------
+ * Function:    Select_cub_isa
+ * Purpose:     Make every row kernel the one for isa (not AUTO)
+ */
+static inline void Select_cub_isa(trap_isa_t isa) {
+   int i;
+
+   for (i = 0; i < CUB_INTEGRAND_COUNT; i++)
+      cub_integrands[i].row = cub_integrands[i].kernels[isa];
+}  /* Select_cub_isa */
+
+/*------------------------------------------------------------------
+ * Function:    List_cub_integrands
+ */
+static inline void List_cub_integrands(FILE* fp) {
+   int i;
+
+   fprintf(fp, "Known 2D and 3D integrands:\n");
+   for (i = 0; i < CUB_INTEGRAND_COUNT; i++)
+      fprintf(fp, "   %-10s %dD  %s\n", cub_integrands[i].name,
+            cub_integrands[i].dims, cub_integrands[i].formula);
+}  /* List_cub_integrands */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_grid_init
+ * Purpose:     Set up the grid for dims axes; a, b and n hold dims
+ *              entries each.  Axes past dims get one point.
+ */
+static inline void Cub_grid_init(cub_grid_t* g_p, int dims,
+      const double a[], const double b[], const int n[]) {
+   static const int tile[3] = {CUB_TILE_X, CUB_TILE_Y, CUB_TILE_Z};
+   int d;
+
+   g_p->dims = dims;
+   for (d = 0; d < 3; d++) {
+      g_p->a[d] = d < dims ? a[d] : 0.0;
+      g_p->b[d] = d < dims ? b[d] : 0.0;
+      g_p->n[d] = d < dims ? n[d] : 0;
+      g_p->h[d] = d < dims ? (g_p->b[d] - g_p->a[d])/g_p->n[d] : 1.0;
+      g_p->tiles[d] = g_p->n[d]/tile[d] + 1;   /* n[d]+1 points */
+   }
+}  /* Cub_grid_init */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_tile_count
+ */
+static inline long Cub_tile_count(const cub_grid_t* g_p) {
+   return (long) g_p->tiles[0]*g_p->tiles[1]*g_p->tiles[2];
+}  /* Cub_tile_count */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_weight
+ * Purpose:     Trapezoidal weight of point i of n intervals
+ */
+static inline double Cub_weight(int i, int n) {
+   return (n > 0 && (i == 0 || i == n)) ? 0.5 : 1.0;
+}  /* Cub_weight */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_tile
+ * Purpose:     Weighted sum of f over the points of one tile
+ * Return val:  The sum; the integral is the sum over all tiles times
+ *              h[0]*h[1]*h[2]
+ */
+static inline double Cub_tile(const cub_integrand_t* f_p,
+      const cub_grid_t* g_p, long tile) {
+   int t[3], lo[3], hi[3], d, j, k;
+   static const int size[3] = {CUB_TILE_X, CUB_TILE_Y, CUB_TILE_Z};
+   double y, z, w, row, sum = 0.0;
+
+   t[0] = (int) (tile % g_p->tiles[0]);
+   t[1] = (int) (tile/g_p->tiles[0] % g_p->tiles[1]);
+   t[2] = (int) (tile/g_p->tiles[0]/g_p->tiles[1]);
+   for (d = 0; d < 3; d++) {
+      lo[d] = t[d]*size[d];
+      hi[d] = lo[d] + size[d] - 1;
+      if (hi[d] > g_p->n[d]) hi[d] = g_p->n[d];
+   }
+
+   for (k = lo[2]; k <= hi[2]; k++) {
+      z = g_p->a[2] + k*g_p->h[2];
+      for (j = lo[1]; j <= hi[1]; j++) {
+         y = g_p->a[1] + j*g_p->h[1];
+         w = Cub_weight(j, g_p->n[1])*Cub_weight(k, g_p->n[2]);
+         row = f_p->row(g_p->a[0], g_p->h[0], lo[0], hi[0], y, z);
+         if (lo[0] == 0)
+            row -= 0.5*f_p->f(g_p->a[0], y, z);
+         if (hi[0] == g_p->n[0])
+            row -= 0.5*f_p->f(g_p->b[0], y, z);
+         sum += w*row;
+      }
+   }
+   return sum;
+}  /* Cub_tile */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_cell_volume
+ * Purpose:     h[0]*h[1]*h[2], the factor applied to the tile sums
+ */
+static inline double Cub_cell_volume(const cub_grid_t* g_p) {
+   return g_p->h[0]*g_p->h[1]*g_p->h[2];
+}  /* Cub_cell_volume */
+
+/*------------------------------------------------------------------
+ * Function:    Read_cub_box
+ * Purpose:     Read a, b for each axis and then n from stdin
+ * Return val:  0 on success, -1 on bad input
+ */
+static inline int Read_cub_box(int dims, double a[], double b[], int n[]) {
+   int d, count;
+
+   printf("Enter a, b for each of the %d axes, and n\n", dims);
+   for (d = 0; d < dims; d++)
+      if (scanf("%lf %lf", &a[d], &b[d]) != 2) return -1;
+   if (scanf("%d", &count) != 1 || count < 1) return -1;
+   for (d = 0; d < dims; d++)
+      n[d] = count;
+   return 0;
+}  /* Read_cub_box */
+
+/*------------------------------------------------------------------
+ * Function:    Print_cub_result
+ */
+static inline void Print_cub_result(const cub_integrand_t* f_p,
+      const cub_grid_t* g_p, double result) {
+   int d;
+
+   printf("With n = %d intervals per axis, our estimate\n", g_p->n[0]);
+   printf("of the integral of %s over ", f_p->formula);
+   for (d = 0; d < g_p->dims; d++)
+      printf("%s[%f, %f]", d > 0 ? " x " : "", g_p->a[d], g_p->b[d]);
+   printf(" = %.15e\n", result);
+}  /* Print_cub_result */
+
+#endif
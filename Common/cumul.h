@@ -0,0 +1,119 @@
+/* File:     cumul.h
+ * Purpose:  Cumulative integral F(x_i), the integral from a to
+ *           x_i = a + i*h by the trapezoidal rule, at every k-th grid
+ *           point i = 0, k, 2k, ..., computed with a parallel prefix
+ *           scan.
+ *
+ *           The output points are split into contiguous blocks, one
+ *           per thread or process, and the scan takes two passes:
+ *
+ *              1.  Each part fills in the prefix sums of its own block
+ *                  (Cumul_prefix), starting from 0.
+ *              2.  The block totals are scanned (a loop over the
+ *                  threads, or MPI_Exscan), and each part adds the sum
+ *                  of the blocks before it to its values and formats
+ *                  them (Cumul_format).
+ *
+ *           so f is evaluated once at every grid point and the whole
+ *           table costs O(n) work.
+ *
+ * Output:   The table is text, one fixed width record
+ *
+ *              "%24.16e %24.16e\n"  (x_i, F(x_i))
+ *
+ *           of CUMUL_RECORD bytes per output point, so every part
+ *           knows where its records go in the file without talking to
+ *           the others.
+ */
+#ifndef CUMUL_H
+#define CUMUL_H
+
+#include <stdio.h>
+#include <string.h>
+#include "integrands.h"
+
+#define CUMUL_RECORD 50   /* Bytes in one "%24.16e %24.16e\n" record */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_point_count
+ * Purpose:     Number of output points i = 0, k, 2k, ... <= n
+ */
+static inline int Cumul_point_count(int n, int k) {
+   return n/k + 1;
+}  /* Cumul_point_count */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_prefix
+ * Purpose:     Pass 1 of the scan: the integral from output point
+ *              j0-1 (or from a, if j0 = 0) to each output point j,
+ *              j0 <= j < j1
+ * Input args:  integrand, a, h, k
+ *              j0, j1:  the block of output points
+ * Output args: values:  values[j-j0] for j0 <= j < j1
+ * Return val:  The integral over the whole block (values[j1-j0-1])
+ */
+static inline double Cumul_prefix(const integrand_t* integrand, double a,
+      double h, int k, int j0, int j1, double values[]) {
+   double sum = 0.0, f_prev, f_next;
+   int j, i;
+
+   i = j0 > 0 ? (j0 - 1)*k : 0;
+   f_prev = integrand->f(a + i*h);
+   for (j = j0; j < j1; j++) {
+      if (j > 0) {
+         i = j*k;
+         f_next = integrand->f(a + i*h);
+         sum += h*((f_prev + f_next)/2.0
+               + (k > 1 ? integrand->sum(a, h, i - k + 1, i - 1) : 0.0));
+         f_prev = f_next;
+      }
+      values[j - j0] = sum;
+   }
+   return sum;
+}  /* Cumul_prefix */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_tail
+ * Purpose:     Integral from the last output point to b, which is
+ *              only needed for the total when k doesn't divide n
+ */
+static inline double Cumul_tail(const integrand_t* integrand, double a,
+      double h, int n, int k) {
+   int i0 = n/k*k;
+
+   if (i0 == n) return 0.0;
+   return h*((integrand->f(a + i0*h) + integrand->f(a + n*h))/2.0
+         + (n - i0 > 1 ? integrand->sum(a, h, i0 + 1, n - 1) : 0.0));
+}  /* Cumul_tail */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_format
+ * Purpose:     Pass 2 of the scan: add offset to values[0..count-1],
+ *              the output points j0, ..., j0+count-1, and write their
+ *              records to buf
+ * Output args: buf:  count*CUMUL_RECORD bytes, not NUL terminated
+ */
+static inline void Cumul_format(char* buf, double a, double h, int k,
+      int j0, int count, const double values[], double offset) {
+   char record[CUMUL_RECORD + 1];
+   int j;
+
+   for (j = 0; j < count; j++) {
+      snprintf(record, sizeof(record), "%24.16e %24.16e\n",
+            a + ((j0 + j)*k)*h, offset + values[j]);
+      memcpy(buf + (size_t) j*CUMUL_RECORD, record, CUMUL_RECORD);
+   }
+}  /* Cumul_format */
+
+/*------------------------------------------------------------------
+ * Function:    Print_cumul_result
+ */
+static inline void Print_cumul_result(const integrand_t* integrand,
+      double a, double b, int n, int k, const char* fname, double total) {
+   printf("Wrote F(x) at %d points (every %d of n = %d) to %s\n",
+         Cumul_point_count(n, k), k, n, fname);
+   printf("F(b) = integral of %s from %f to %f = %.15e\n",
+         integrand->formula, a, b, total);
+}  /* Print_cumul_result */
+
+#endif
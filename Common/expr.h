@@ -0,0 +1,470 @@
+/* File:     expr.h
+ * Purpose:  Integrands given on the command line as an expression in
+ *           x (-expr "exp(-x*x)*cos(3*x)"), for integrands that aren't
+ *           worth adding to integrands.h and recompiling.
+ *
+ *           The expression is parsed once into the bytecode of a stack
+ *           machine.  The inner loop (Sum_expr_<isa>) then runs the
+ *           bytecode over blocks of EXPR_BLOCK abscissas: each stack
+ *           slot holds a whole block, and each instruction is a fixed
+ *           length loop over the block that the compiler vectorizes,
+ *           so decoding an instruction costs once per EXPR_BLOCK
+ *           evaluations of f instead of once per evaluation.
+ *
+ * Syntax:   The usual precedence, with ^ (power) binding tighter than
+ *           unary minus (-x^2 = -(x^2)) and grouping right to left:
+ *
+ *              sum     = product {("+" | "-") product}
+ *              product = unary {("*" | "/") unary}
+ *              unary   = ("-" | "+") unary | power
+ *              power   = primary ["^" unary]
+ *              primary = number | "x" | "pi" | "e"
+ *                      | function "(" sum ")" | "(" sum ")"
+ *
+ *           Functions: exp, log, sin, cos, sqrt and abs.  Operations on
+ *           constants are folded when the expression is compiled, and
+ *           u^2 becomes u*u.
+ *
+ * Notes:
+ * 1.  exp, log, sin, cos and ^ use vmath.h.  sqrt only vectorizes if
+ *     the compiler may ignore errno (gcc, clang: -fno-math-errno).
+ * 2.  The last, partial block of a sum is evaluated in full and only
+ *     its first entries are added, so f may be evaluated (and
+ *     discarded) a little past b.
+ */
+#ifndef EXPR_H
+#define EXPR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "integrands.h"
+
+#define EXPR_BLOCK     128   /* Abscissas per block                */
+#define EXPR_MAX_STACK 16    /* Deepest stack an expression may use */
+#define EXPR_MAX_CODE  256   /* Longest bytecode                   */
+
+/* X(op, function name or NULL, result in terms of the operand a) */
+#define EXPR_UNARY_LIST(X) \
+   X(NEG,  NULL,   -a) \
+   X(SQR,  NULL,   a*a) \
+   X(EXP,  "exp",  Vm_exp(a)) \
+   X(LOG,  "log",  Vm_log(a)) \
+   X(SIN,  "sin",  Vm_sin(a)) \
+   X(COS,  "cos",  Vm_cos(a)) \
+   X(SQRT, "sqrt", sqrt(a)) \
+   X(ABS,  "abs",  fabs(a))
+
+/* X(op, operator, result in terms of the operands a, b) */
+#define EXPR_BINARY_LIST(X) \
+   X(ADD,  '+',    a + b) \
+   X(SUB,  '-',    a - b) \
+   X(MUL,  '*',    a*b) \
+   X(DIV,  '/',    a/b) \
+   X(POW,  '^',    Vm_pow(a, b))
+
+#define EXPR_ENUM(op, name, expr) EXPR_##op,
+typedef enum {
+   EXPR_X,          /* push x               */
+   EXPR_CONST,      /* push value[pc]       */
+   EXPR_UNARY_LIST(EXPR_ENUM)
+   EXPR_BINARY_LIST(EXPR_ENUM)
+   EXPR_OP_COUNT
+} expr_op_t;
+#undef EXPR_ENUM
+
+#define EXPR_NAME(op, name, expr) name,
+static const char* const expr_func_names[] = {
+   EXPR_UNARY_LIST(EXPR_NAME)
+};
+#undef EXPR_NAME
+
+#define EXPR_IS_UNARY(op)  ((op) >= EXPR_NEG && (op) < EXPR_ADD)
+#define EXPR_IS_BINARY(op) ((op) >= EXPR_ADD && (op) < EXPR_OP_COUNT)
+
+typedef struct {
+   unsigned char op[EXPR_MAX_CODE];
+   double        value[EXPR_MAX_CODE];  /* constant of EXPR_CONST */
+   int           len;
+} expr_prog_t;
+
+/* The expression -expr compiled, used by the expr integrand */
+static expr_prog_t expr_prog;
+
+/*------------------------------------------------------------------
+ * Function:    Expr_apply
+ * Purpose:     Apply a unary (to a) or binary (to a, b) operation to
+ *              one value
+ */
+static inline double Expr_apply(int op, double a, double b) {
+   switch (op) {
+#define EXPR_UNARY_APPLY(op, name, expr) case EXPR_##op: return (expr);
+#define EXPR_BINARY_APPLY(op, sym, expr) case EXPR_##op: return (expr);
+      EXPR_UNARY_LIST(EXPR_UNARY_APPLY)
+      EXPR_BINARY_LIST(EXPR_BINARY_APPLY)
+#undef EXPR_UNARY_APPLY
+#undef EXPR_BINARY_APPLY
+   }
+   return b;
+}  /* Expr_apply */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_f
+ * Purpose:     Run expr_prog for a single x (the endpoints, adaptive
+ *              Simpson, ...)
+ */
+static inline double Expr_f(double x) {
+   double stack[EXPR_MAX_STACK];
+   int pc, sp = 0;
+   int op;
+
+   for (pc = 0; pc < expr_prog.len; pc++) {
+      op = expr_prog.op[pc];
+      if (op == EXPR_X) {
+         stack[sp++] = x;
+      } else if (op == EXPR_CONST) {
+         stack[sp++] = expr_prog.value[pc];
+      } else if (EXPR_IS_UNARY(op)) {
+         stack[sp-1] = Expr_apply(op, stack[sp-1], 0.0);
+      } else {
+         stack[sp-2] = Expr_apply(op, stack[sp-2], stack[sp-1]);
+         sp--;
+      }
+   }
+   return stack[0];
+}  /* Expr_f */
+
+/*------------------------------------------------------------------
+ * Macro:       DEFINE_EXPR_BLOCK
+ * Purpose:     Define block(x0, h, first, stack), which runs expr_prog
+ *              for x = x0 + i*h, first <= i < first + EXPR_BLOCK, and
+ *              leaves the values of the expression in stack[0]
+ */
+#define EXPR_UNARY_CASE(op, name, expr)                              \
+   case EXPR_##op: {                                                 \
+      double* restrict r = stack[sp-1];                              \
+      for (i = 0; i < EXPR_BLOCK; i++) {                             \
+         double a = r[i];                                            \
+         r[i] = (expr);                                              \
+      }                                                              \
+   }  break;
+#define EXPR_BINARY_CASE(op, sym, expr)                              \
+   case EXPR_##op: {                                                 \
+      double* restrict r = stack[sp-2];                              \
+      const double* restrict q = stack[sp-1];                        \
+      for (i = 0; i < EXPR_BLOCK; i++) {                             \
+         double a = r[i], b = q[i];                                  \
+         r[i] = (expr);                                              \
+      }                                                              \
+      sp--;                                                          \
+   }  break;
+
+#define DEFINE_EXPR_BLOCK(block, target)                             \
+   static target void block(double x0, double h, int first,          \
+         double stack[][EXPR_BLOCK]) {                               \
+      int pc, sp = 0, i;                                             \
+                                                                     \
+      for (pc = 0; pc < expr_prog.len; pc++) {                       \
+         switch (expr_prog.op[pc]) {                                 \
+         case EXPR_X: {                                              \
+            double* restrict r = stack[sp++];                        \
+            for (i = 0; i < EXPR_BLOCK; i++)                         \
+               r[i] = x0 + (first + i)*h;                            \
+         }  break;                                                   \
+         case EXPR_CONST: {                                          \
+            double* restrict r = stack[sp++];                        \
+            double value = expr_prog.value[pc];                      \
+            for (i = 0; i < EXPR_BLOCK; i++)                         \
+               r[i] = value;                                         \
+         }  break;                                                   \
+         EXPR_UNARY_LIST(EXPR_UNARY_CASE)                            \
+         EXPR_BINARY_LIST(EXPR_BINARY_CASE)                          \
+         }                                                           \
+      }                                                              \
+   }
+
+/*------------------------------------------------------------------
+ * Macro:       DEFINE_EXPR_SUM
+ * Purpose:     Define kernel(x0, h, first, last), the sum of the
+ *              expression at x0 + i*h for first <= i <= last, a
+ *              trap_sum_fn like the ones in trap_isa.h
+ */
+#define DEFINE_EXPR_SUM(kernel, block, target)                       \
+   DEFINE_EXPR_BLOCK(block, target)                                  \
+   static target double kernel(double x0, double h, int first,       \
+         int last) {                                                 \
+      double stack[EXPR_MAX_STACK][EXPR_BLOCK];                      \
+      double acc[EXPR_BLOCK];                                        \
+      double sum = 0.0;                                              \
+      int i, j;                                                      \
+                                                                     \
+      for (j = 0; j < EXPR_BLOCK; j++)                               \
+         acc[j] = 0.0;                                               \
+      for (i = first; i <= last - (EXPR_BLOCK-1); i += EXPR_BLOCK) { \
+         block(x0, h, i, stack);                                     \
+         for (j = 0; j < EXPR_BLOCK; j++)                            \
+            acc[j] += stack[0][j];                                   \
+      }                                                              \
+      if (i <= last) {                                               \
+         block(x0, h, i, stack);                                     \
+         for (j = 0; j <= last - i; j++)                             \
+            sum += stack[0][j];                                      \
+      }                                                              \
+      for (j = EXPR_BLOCK/2; j > 0; j /= 2)                          \
+         for (i = 0; i < j; i++)                                     \
+            acc[i] += acc[i+j];                                      \
+      return sum + acc[0];                                           \
+   }
+
+DEFINE_EXPR_SUM(Sum_expr_generic, Expr_block_generic, TRAP_TARGET_GENERIC)
+#if TRAP_HAVE_X86_KERNELS
+DEFINE_EXPR_SUM(Sum_expr_avx2, Expr_block_avx2, TRAP_TARGET_AVX2)
+DEFINE_EXPR_SUM(Sum_expr_avx512, Expr_block_avx512, TRAP_TARGET_AVX512)
+#define EXPR_KERNELS {Sum_expr_generic, Sum_expr_avx2, Sum_expr_avx512}
+#else
+#define EXPR_KERNELS \
+   {Sum_expr_generic, Sum_expr_generic, Sum_expr_generic}
+#endif
+
+/* Registry entry of the compiled expression; formula is its text */
+static integrand_t expr_integrand =
+   {"expr", NULL, Expr_f, Sum_expr_generic, EXPR_KERNELS};
+
+/* Parser state */
+typedef struct {
+   const char*  text;
+   const char*  p;       /* next character                    */
+   expr_prog_t* prog;
+   int          sp;      /* stack depth after the code so far */
+   int          error;
+   int          verbose; /* print errors                      */
+} expr_parser_t;
+
+/*------------------------------------------------------------------
+ * Function:    Expr_error
+ * Purpose:     Report the first error, and where it is
+ */
+static inline void Expr_error(expr_parser_t* ps, const char* msg) {
+   if (ps->error) return;
+   if (ps->verbose) {
+      fprintf(stderr, "%s in expression %s\n", msg, ps->text);
+      fprintf(stderr, "   at: %s\n", *ps->p != '\0' ? ps->p : "end");
+   }
+   ps->error = 1;
+}  /* Expr_error */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_emit
+ * Purpose:     Append an instruction, folding it into the code before
+ *              it if all its operands are constants
+ */
+static inline void Expr_emit(expr_parser_t* ps, int op, double value) {
+   expr_prog_t* prog = ps->prog;
+   int n = prog->len;
+
+   if (ps->error) return;
+   if (op == EXPR_POW && n >= 1 && prog->op[n-1] == EXPR_CONST
+         && prog->value[n-1] == 2.0
+         && !(n >= 2 && prog->op[n-2] == EXPR_CONST)) {
+      /* u^2 -> u*u */
+      prog->len = --n;
+      ps->sp--;
+      op = EXPR_SQR;
+   }
+   if (EXPR_IS_UNARY(op) && n >= 1 && prog->op[n-1] == EXPR_CONST) {
+      prog->value[n-1] = Expr_apply(op, prog->value[n-1], 0.0);
+      return;
+   }
+   if (EXPR_IS_BINARY(op) && n >= 2 && prog->op[n-1] == EXPR_CONST
+         && prog->op[n-2] == EXPR_CONST) {
+      prog->value[n-2] = Expr_apply(op, prog->value[n-2],
+            prog->value[n-1]);
+      prog->len--;
+      ps->sp--;
+      return;
+   }
+
+   if (n == EXPR_MAX_CODE) {
+      Expr_error(ps, "Too long");
+      return;
+   }
+   prog->op[n] = (unsigned char) op;
+   prog->value[n] = value;
+   prog->len++;
+   if (op == EXPR_X || op == EXPR_CONST)
+      ps->sp++;
+   else if (EXPR_IS_BINARY(op))
+      ps->sp--;
+   if (ps->sp > EXPR_MAX_STACK)
+      Expr_error(ps, "Too deeply nested");
+}  /* Expr_emit */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_skip
+ * Purpose:     Skip blanks, then consume c if it's next
+ * Return val:  1 if c was consumed, else 0
+ */
+static inline int Expr_skip(expr_parser_t* ps, char c) {
+   while (isspace((unsigned char) *ps->p)) ps->p++;
+   if (c != '\0' && *ps->p == c) {
+      ps->p++;
+      return 1;
+   }
+   return 0;
+}  /* Expr_skip */
+
+static inline void Expr_parse_sum(expr_parser_t* ps);
+static inline void Expr_parse_unary(expr_parser_t* ps);
+
+/*------------------------------------------------------------------
+ * Function:    Expr_parse_primary
+ */
+static inline void Expr_parse_primary(expr_parser_t* ps) {
+   char name[16];
+   int len = 0, op;
+   char* end;
+
+   Expr_skip(ps, '\0');
+   if (isdigit((unsigned char) *ps->p) || *ps->p == '.') {
+      Expr_emit(ps, EXPR_CONST, strtod(ps->p, &end));
+      ps->p = end;
+   } else if (isalpha((unsigned char) *ps->p)) {
+      while (isalnum((unsigned char) ps->p[len]) && len < 15) {
+         name[len] = ps->p[len];
+         len++;
+      }
+      name[len] = '\0';
+      ps->p += len;
+      if (strcmp(name, "x") == 0) {
+         Expr_emit(ps, EXPR_X, 0.0);
+      } else if (strcmp(name, "pi") == 0) {
+         Expr_emit(ps, EXPR_CONST, 3.14159265358979323846);
+      } else if (strcmp(name, "e") == 0) {
+         Expr_emit(ps, EXPR_CONST, 2.71828182845904523536);
+      } else {
+         for (op = EXPR_NEG; op < EXPR_ADD; op++)
+            if (expr_func_names[op - EXPR_NEG] != NULL
+                  && strcmp(name, expr_func_names[op - EXPR_NEG]) == 0)
+               break;
+         if (op == EXPR_ADD) {
+            ps->p -= len;
+            Expr_error(ps, "Unknown name");
+         } else if (!Expr_skip(ps, '(')) {
+            Expr_error(ps, "Expected (");
+         } else {
+            Expr_parse_sum(ps);
+            if (!Expr_skip(ps, ')')) Expr_error(ps, "Expected )");
+            Expr_emit(ps, op, 0.0);
+         }
+      }
+   } else if (Expr_skip(ps, '(')) {
+      Expr_parse_sum(ps);
+      if (!Expr_skip(ps, ')')) Expr_error(ps, "Expected )");
+   } else {
+      Expr_error(ps, "Expected a number, x, a function or (");
+   }
+}  /* Expr_parse_primary */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_parse_unary
+ * Purpose:     Parse unary, including power
+ */
+static inline void Expr_parse_unary(expr_parser_t* ps) {
+   if (ps->error) return;
+   if (Expr_skip(ps, '-')) {
+      Expr_parse_unary(ps);
+      Expr_emit(ps, EXPR_NEG, 0.0);
+   } else if (Expr_skip(ps, '+')) {
+      Expr_parse_unary(ps);
+   } else {
+      Expr_parse_primary(ps);
+      if (Expr_skip(ps, '^')) {
+         Expr_parse_unary(ps);
+         Expr_emit(ps, EXPR_POW, 0.0);
+      }
+   }
+}  /* Expr_parse_unary */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_parse_product
+ */
+static inline void Expr_parse_product(expr_parser_t* ps) {
+   Expr_parse_unary(ps);
+   while (!ps->error) {
+      if (Expr_skip(ps, '*')) {
+         Expr_parse_unary(ps);
+         Expr_emit(ps, EXPR_MUL, 0.0);
+      } else if (Expr_skip(ps, '/')) {
+         Expr_parse_unary(ps);
+         Expr_emit(ps, EXPR_DIV, 0.0);
+      } else {
+         break;
+      }
+   }
+}  /* Expr_parse_product */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_parse_sum
+ */
+static inline void Expr_parse_sum(expr_parser_t* ps) {
+   Expr_parse_product(ps);
+   while (!ps->error) {
+      if (Expr_skip(ps, '+')) {
+         Expr_parse_product(ps);
+         Expr_emit(ps, EXPR_ADD, 0.0);
+      } else if (Expr_skip(ps, '-')) {
+         Expr_parse_product(ps);
+         Expr_emit(ps, EXPR_SUB, 0.0);
+      } else {
+         break;
+      }
+   }
+}  /* Expr_parse_sum */
+
+/*------------------------------------------------------------------
+ * Function:    Expr_compile
+ * Purpose:     Compile text into prog
+ * Input args:  verbose:  nonzero if errors should be printed
+ * Return val:  0 on success, -1 (after printing a message) if text
+ *              isn't a valid expression
+ */
+static inline int Expr_compile(const char* text, expr_prog_t* prog,
+      int verbose) {
+   expr_parser_t ps;
+
+   ps.text = ps.p = text;
+   ps.prog = prog;
+   ps.sp = 0;
+   ps.error = 0;
+   ps.verbose = verbose;
+   prog->len = 0;
+
+   Expr_parse_sum(&ps);
+   Expr_skip(&ps, '\0');
+   if (*ps.p != '\0') Expr_error(&ps, "Unexpected character");
+   return ps.error ? -1 : 0;
+}  /* Expr_compile */
+
+/*------------------------------------------------------------------
+ * Function:    Set_expr_integrand
+ * Purpose:     Compile text as the expr integrand
+ * Return val:  The expr integrand, or NULL if text isn't valid
+ */
+static inline const integrand_t* Set_expr_integrand(const char* text,
+      int verbose) {
+   if (Expr_compile(text, &expr_prog, verbose) != 0) return NULL;
+   expr_integrand.formula = text;
+   return &expr_integrand;
+}  /* Set_expr_integrand */
+
+/*------------------------------------------------------------------
+ * Function:    Select_expr_isa
+ * Purpose:     Make the expr integrand's sum use the kernel for isa
+ */
+static inline void Select_expr_isa(trap_isa_t isa) {
+   expr_integrand.sum = expr_integrand.kernels[isa];
+}  /* Select_expr_isa */
+
+#endif
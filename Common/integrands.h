@@ -0,0 +1,150 @@
+/* File:     integrands.h
+ * Purpose:  Registry of the integrands known to the trapezoidal rule
+ *           programs (OpenMP/omp_trap.c, Pthreads/pth_trap.c and
+ *           MPI/mpi_trap4.c).
+ *
+ *           Every integrand is listed once in INTEGRAND_LIST.  For each
+ *           entry the preprocessor generates
+ *
+ *              F_<name>:    the integrand itself, static inline
+ *              Sum_<name>_<isa>:
+ *                           the inner loop of the trapezoidal rule,
+ *                           sum of f(x0 + i*h) for first <= i <= last,
+ *                           with F_<name> inlined into the loop body,
+ *                           once for each ISA in trap_isa.h
+ *
+ *           so choosing an integrand at run time costs one indirect
+ *           call per Trap call instead of one per abscissa.
+ *           Select_trap_isa points every entry's sum at the kernels
+ *           for one ISA.
+ *
+ * Adding an integrand:
+ *    Add a line X(name, "formula", expression in x) to INTEGRAND_LIST,
+ *    or put such lines in a USER_INTEGRANDS(X) macro in a header of
+ *    your own and compile with -DUSER_INTEGRANDS_FILE='"my_file.h"'.
+ *    Use Vm_exp, Vm_log, Vm_sin, Vm_cos and Vm_pow from vmath.h rather
+ *    than the libm functions, or the inner loop won't vectorize.
+ *
+ * Usage:    #include "../Common/integrands.h"
+ *           const integrand_t* f = Find_integrand("gauss");
+ *           sum = f->sum(a, h, 1, n-1);
+ */
+#ifndef INTEGRANDS_H
+#define INTEGRANDS_H
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "trap_isa.h"
+#include "vmath.h"
+
+#ifdef USER_INTEGRANDS_FILE
+#include USER_INTEGRANDS_FILE
+#endif
+#ifndef USER_INTEGRANDS
+#define USER_INTEGRANDS(X)
+#endif
+
+/* The integrand used when none is named on the command line */
+#define DEFAULT_INTEGRAND "square"
+
+/* X(name, formula, expression in x) */
+#define INTEGRAND_LIST(X) \
+   X(square,   "x*x",                 x*x) \
+   X(cube,     "x*x*x",               x*x*x) \
+   X(poly5,    "x^5-3x^3+2x-1",       ((x*x - 3.0)*x*x + 2.0)*x - 1.0) \
+   X(rational, "1/(1+x*x)",           1.0/(1.0 + x*x)) \
+   X(gauss,    "exp(-x*x)",           Vm_exp(-x*x)) \
+   X(exp_sin,  "exp(-x)*sin(x)",      Vm_exp(-x)*Vm_sin(x)) \
+   X(sin_cos,  "sin(x)+cos(3x)",      Vm_sin(x) + Vm_cos(3.0*x)) \
+   USER_INTEGRANDS(X)
+
+typedef double (*integrand_fn)(double x);
+typedef double (*trap_sum_fn)(double x0, double h, int first, int last);
+
+typedef struct {
+   const char*   name;
+   const char*   formula;
+   integrand_fn  f;     /* f(x), for endpoints and odd jobs   */
+   trap_sum_fn   sum;   /* sum of f(x0+i*h), first <= i <= last */
+   trap_sum_fn   kernels[TRAP_ISA_COUNT];  /* sum for each ISA    */
+} integrand_t;
+
+#if TRAP_HAVE_X86_KERNELS
+#define DEFINE_ISA_KERNELS(name)                                     \
+   DEFINE_TRAP_SUM(Sum_##name##_avx2, TRAP_TARGET_AVX2, F_##name)    \
+   DEFINE_TRAP_SUM(Sum_##name##_avx512, TRAP_TARGET_AVX512, F_##name)
+#define ISA_KERNELS(name) \
+   {Sum_##name##_generic, Sum_##name##_avx2, Sum_##name##_avx512}
+#else
+#define DEFINE_ISA_KERNELS(name)
+#define ISA_KERNELS(name) \
+   {Sum_##name##_generic, Sum_##name##_generic, Sum_##name##_generic}
+#endif
+
+#define DEFINE_INTEGRAND(name, formula, expr)                        \
+   static inline double F_##name(double x) {                         \
+      return (expr);                                                 \
+   }                                                                 \
+   DEFINE_TRAP_SUM(Sum_##name##_generic, TRAP_TARGET_GENERIC, F_##name) \
+   DEFINE_ISA_KERNELS(name)
+
+INTEGRAND_LIST(DEFINE_INTEGRAND)
+
+#define INTEGRAND_ENTRY(name, formula, expr) \
+   {#name, formula, F_##name, Sum_##name##_generic, ISA_KERNELS(name)},
+
+static integrand_t integrands[] = {
+   INTEGRAND_LIST(INTEGRAND_ENTRY)
+};
+
+#define INTEGRAND_COUNT ((int) (sizeof(integrands)/sizeof(integrands[0])))
+
+/*------------------------------------------------------------------
+ * Function:    Find_integrand
+ * Purpose:     Look up an integrand by name
+ * Input args:  name
+ * Return val:  Pointer to the registry entry, or NULL if there is
+ *              no integrand with that name
+ */
+static inline const integrand_t* Find_integrand(const char* name) {
+   int i;
+
+   for (i = 0; i < INTEGRAND_COUNT; i++)
+      if (strcmp(integrands[i].name, name) == 0)
+         return &integrands[i];
+   return NULL;
+}  /* Find_integrand */
+
+/*------------------------------------------------------------------
+ * Function:    Select_trap_isa
+ * Purpose:     Make every integrand's sum use the kernels for isa
+ * Input args:  isa:  an ISA, or TRAP_ISA_AUTO for the best one the
+ *                    CPU supports
+ * Return val:  The ISA selected
+ */
+static inline trap_isa_t Select_trap_isa(trap_isa_t isa) {
+   int i;
+
+   if (isa == TRAP_ISA_AUTO)
+      isa = Best_trap_isa();
+   for (i = 0; i < INTEGRAND_COUNT; i++)
+      integrands[i].sum = integrands[i].kernels[isa];
+   return isa;
+}  /* Select_trap_isa */
+
+/*------------------------------------------------------------------
+ * Function:    List_integrands
+ * Purpose:     Print the names and formulas of the known integrands
+ * Input args:  fp:  stream to print to
+ */
+static inline void List_integrands(FILE* fp) {
+   int i;
+
+   fprintf(fp, "Known integrands:\n");
+   for (i = 0; i < INTEGRAND_COUNT; i++)
+      fprintf(fp, "   %-10s %s\n", integrands[i].name,
+            integrands[i].formula);
+}  /* List_integrands */
+
+#endif
@@ -0,0 +1,389 @@
+/* File:     qmc.h
+ * Purpose:  Monte Carlo and quasi-Monte Carlo integration over the
+ *           cube [a, b]^d, shared by the trapezoidal rule programs.
+ *
+ *           Point i of every sequence is a function of i alone:
+ *
+ *              mc:      Philox4x32-10 applied to the counter (i, j/2)
+ *                       under the key seed, so every thread or process
+ *                       draws its own samples with no shared state
+ *              halton:  radical inverse of i+1 in the j-th prime base
+ *              sobol:   Sobol' points in Gray code order, with the
+ *                       Joe-Kuo direction numbers (2^32 points at most)
+ *
+ *           so the programs just give each thread or process a block of
+ *           indices, and the estimate doesn't depend on how many there
+ *           are (up to the order of the final additions).  Points are
+ *           made QMC_BLOCK at a time and stored one array per
+ *           coordinate, and the integrand is evaluated over the whole
+ *           block in loops the compiler can vectorize.
+ *
+ * Adding an integrand:
+ *    Add X(name, "formula", init, combine, final) to QMC_INTEGRAND_LIST.
+ *    f(x) is computed as v = init; v = combine for each coordinate x;
+ *    f = final, where combine and final are expressions in v and x
+ *    (using the Vm_ functions of vmath.h rather than libm).
+ */
+#ifndef QMC_H
+#define QMC_H
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "trap_isa.h"
+#include "vmath.h"
+
+#define QMC_MAX_DIMS 16
+#define QMC_BLOCK    64
+#define QMC_SOBOL_MAX (1LL << 32)   /* Sobol' points with 32-bit v[j] */
+
+/* X(name, formula, init, combine, final) */
+#define QMC_INTEGRAND_LIST(X) \
+   X(sum_sq,   "sum x_j^2",           0.0, v + x*x,         v) \
+   X(gauss_nd, "exp(-sum x_j^2)",     0.0, v + x*x,         Vm_exp(-v)) \
+   X(prod_cos, "prod cos(x_j)",       1.0, v*Vm_cos(x),     v) \
+   X(genz,     "prod 1/(1+x_j^2)",    1.0, v/(1.0 + x*x),   v)
+
+typedef enum { QMC_MC, QMC_HALTON, QMC_SOBOL, QMC_SEQ_COUNT } qmc_seq_t;
+
+static const char* const qmc_seq_names[QMC_SEQ_COUNT] =
+   {"mc", "halton", "sobol"};
+
+typedef void (*qmc_block_fn)(double x[][QMC_BLOCK], int dims,
+      int count, double* sum_p, double* sumsq_p);
+
+typedef struct {
+   const char*   name;
+   const char*   formula;
+   qmc_block_fn  block;   /* adds f and f^2 over a block of points */
+   qmc_block_fn  kernels[TRAP_ISA_COUNT];
+} qmc_integrand_t;
+
+typedef struct {
+   qmc_seq_t  seq;
+   int        dims;
+   double     a, b;
+   uint64_t   seed;
+   uint32_t   v[QMC_MAX_DIMS][32];   /* Sobol' direction numbers */
+} qmc_gen_t;
+
+/*------------------------------------------------------------------
+ * Macro:       DEFINE_QMC_BLOCK
+ * Purpose:     Define the block kernel of an integrand
+ */
+#define DEFINE_QMC_BLOCK(kernel, target, init, combine, final)       \
+   static target void kernel(double x_[][QMC_BLOCK], int dims,       \
+         int count, double* sum_p, double* sumsq_p) {                \
+      double val[QMC_BLOCK];                                         \
+      double sum = 0.0, sumsq = 0.0;                                 \
+      int j, k;                                                      \
+                                                                     \
+      /* Whole blocks, so the trip counts are constants */           \
+      for (k = 0; k < QMC_BLOCK; k++)                                \
+         val[k] = (init);                                            \
+      for (j = 0; j < dims; j++)                                     \
+         for (k = 0; k < QMC_BLOCK; k++) {                           \
+            double v = val[k], x = x_[j][k];                         \
+            val[k] = (combine);                                      \
+         }                                                           \
+      for (k = 0; k < QMC_BLOCK; k++) {                              \
+         double v = val[k];                                          \
+         val[k] = (final);                                           \
+      }                                                              \
+      for (k = 0; k < count; k++) {                                  \
+         sum += val[k];                                              \
+         sumsq += val[k]*val[k];                                     \
+      }                                                              \
+      *sum_p += sum;                                                 \
+      *sumsq_p += sumsq;                                             \
+   }
+
+#if TRAP_HAVE_X86_KERNELS
+#define DEFINE_QMC_ISA_BLOCKS(name, init, combine, final)            \
+   DEFINE_QMC_BLOCK(Qmc_##name##_avx2, TRAP_TARGET_AVX2,             \
+         init, combine, final)                                       \
+   DEFINE_QMC_BLOCK(Qmc_##name##_avx512, TRAP_TARGET_AVX512,         \
+         init, combine, final)
+#define QMC_ISA_BLOCKS(name) \
+   {Qmc_##name##_generic, Qmc_##name##_avx2, Qmc_##name##_avx512}
+#else
+#define DEFINE_QMC_ISA_BLOCKS(name, init, combine, final)
+#define QMC_ISA_BLOCKS(name) \
+   {Qmc_##name##_generic, Qmc_##name##_generic, Qmc_##name##_generic}
+#endif
+
+#define DEFINE_QMC_INTEGRAND(name, formula, init, combine, final)    \
+   DEFINE_QMC_BLOCK(Qmc_##name##_generic, TRAP_TARGET_GENERIC,       \
+         init, combine, final)                                       \
+   DEFINE_QMC_ISA_BLOCKS(name, init, combine, final)
+
+QMC_INTEGRAND_LIST(DEFINE_QMC_INTEGRAND)
+
+#define QMC_INTEGRAND_ENTRY(name, formula, init, combine, final) \
+   {#name, formula, Qmc_##name##_generic, QMC_ISA_BLOCKS(name)},
+
+static qmc_integrand_t qmc_integrands[] = {
+   QMC_INTEGRAND_LIST(QMC_INTEGRAND_ENTRY)
+};
+
+#define QMC_INTEGRAND_COUNT \
+   ((int) (sizeof(qmc_integrands)/sizeof(qmc_integrands[0])))
+
+/*------------------------------------------------------------------
+ * Function:    Find_qmc_integrand / Find_qmc_seq
+ * Return val:  The integrand (NULL) or sequence (QMC_SEQ_COUNT)
+ *              called name, or the value in parentheses if unknown
+ */
+static inline const qmc_integrand_t* Find_qmc_integrand(const char* name) {
+   int i;
+
+   for (i = 0; i < QMC_INTEGRAND_COUNT; i++)
+      if (strcmp(qmc_integrands[i].name, name) == 0)
+         return &qmc_integrands[i];
+   return NULL;
+}  /* Find_qmc_integrand */
+
+static inline qmc_seq_t Find_qmc_seq(const char* name) {
+   int i;
+
+   for (i = 0; i < QMC_SEQ_COUNT; i++)
+      if (strcmp(qmc_seq_names[i], name) == 0)
+         return (qmc_seq_t) i;
+   return QMC_SEQ_COUNT;
+}  /* Find_qmc_seq */
+
+/*------------------------------------------------------------------
+ * Function:    Select_qmc_isa
+ * Purpose:     Make every block kernel the one for isa (not AUTO)
+ */
+static inline void Select_qmc_isa(trap_isa_t isa) {
+   int i;
+
+   for (i = 0; i < QMC_INTEGRAND_COUNT; i++)
+      qmc_integrands[i].block = qmc_integrands[i].kernels[isa];
+}  /* Select_qmc_isa */
+
+/*------------------------------------------------------------------
+ * Function:    List_qmc_integrands
+ */
+static inline void List_qmc_integrands(FILE* fp) {
+   int i;
+
+   fprintf(fp, "Known d-dimensional integrands (d <= %d):\n", QMC_MAX_DIMS);
+   for (i = 0; i < QMC_INTEGRAND_COUNT; i++)
+      fprintf(fp, "   %-10s %s\n", qmc_integrands[i].name,
+            qmc_integrands[i].formula);
+}  /* List_qmc_integrands */
+
+/*------------------------------------------------------------------
+ * Function:    Philox4x32
+ * Purpose:     Philox4x32-10 counter-based generator (Salmon et al.,
+ *              SC11): out is a pseudo-random function of ctr and key
+ */
+static inline void Philox4x32(const uint32_t ctr[4], const uint32_t key[2],
+      uint32_t out[4]) {
+   uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+   uint32_t k0 = key[0], k1 = key[1];
+   uint64_t p0, p1;
+   int r;
+
+   for (r = 0; r < 10; r++) {
+      p0 = (uint64_t) 0xD2511F53u*c0;
+      p1 = (uint64_t) 0xCD9E8D57u*c2;
+      c0 = (uint32_t) (p1 >> 32) ^ c1 ^ k0;
+      c2 = (uint32_t) (p0 >> 32) ^ c3 ^ k1;
+      c1 = (uint32_t) p1;
+      c3 = (uint32_t) p0;
+      k0 += 0x9E3779B9u;
+      k1 += 0xBB67AE85u;
+   }
+   out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}  /* Philox4x32 */
+
+/*------------------------------------------------------------------
+ * Function:    Qmc_init
+ * Purpose:     Set up a generator for dims <= QMC_MAX_DIMS coordinates
+ *              scaled to [a, b]
+ */
+static inline void Qmc_init(qmc_gen_t* gen_p, qmc_seq_t seq, int dims,
+      double a, double b, uint64_t seed) {
+   /* Joe-Kuo new-joe-kuo-6.21201: degree s, coefficients a, m_1..m_s
+    * of dimensions 2-16.  Dimension 1 is van der Corput's sequence. */
+   static const int s_tab[QMC_MAX_DIMS] =
+      {0, 1, 2, 3, 3, 4, 4, 5, 5, 5, 5, 5, 5, 6, 6, 6};
+   static const int a_tab[QMC_MAX_DIMS] =
+      {0, 0, 1, 1, 2, 1, 4, 2, 4, 7, 11, 13, 14, 1, 13, 16};
+   static const int m_tab[QMC_MAX_DIMS][6] = {
+      {0}, {1}, {1, 3}, {1, 3, 1}, {1, 1, 1}, {1, 1, 3, 3},
+      {1, 3, 5, 13}, {1, 1, 5, 5, 17}, {1, 1, 5, 5, 5},
+      {1, 1, 7, 11, 19}, {1, 1, 5, 1, 1}, {1, 1, 1, 3, 11},
+      {1, 3, 5, 5, 31}, {1, 3, 3, 9, 7, 49}, {1, 1, 1, 15, 21, 21},
+      {1, 3, 1, 13, 27, 49}};
+   int j, k, l, s;
+
+   gen_p->seq = seq;
+   gen_p->dims = dims;
+   gen_p->a = a;
+   gen_p->b = b;
+   gen_p->seed = seed;
+
+   for (k = 0; k < 32; k++)
+      gen_p->v[0][k] = (uint32_t) 1 << (31 - k);
+   for (j = 1; j < QMC_MAX_DIMS; j++) {
+      s = s_tab[j];
+      for (k = 0; k < 32; k++) {
+         if (k < s) {
+            gen_p->v[j][k] = (uint32_t) m_tab[j][k] << (31 - k);
+         } else {
+            gen_p->v[j][k] = gen_p->v[j][k-s] ^ (gen_p->v[j][k-s] >> s);
+            for (l = 1; l < s; l++)
+               if ((a_tab[j] >> (s - 1 - l)) & 1)
+                  gen_p->v[j][k] ^= gen_p->v[j][k-l];
+         }
+      }
+   }
+}  /* Qmc_init */
+
+/*------------------------------------------------------------------
+ * Function:    Qmc_points
+ * Purpose:     Make points first, ..., first+count-1 (count <=
+ *              QMC_BLOCK), scaled to [a, b]; coordinate j of point
+ *              first+k goes in x[j][k]
+ */
+static inline void Qmc_points(const qmc_gen_t* gen_p, long long first,
+      int count, double x[][QMC_BLOCK]) {
+   static const int primes[QMC_MAX_DIMS] =
+      {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53};
+   const double scale = gen_p->b - gen_p->a;
+   uint32_t ctr[4], key[2], out[4], gray, state[QMC_MAX_DIMS];
+   long long i;
+   double u, inv, digit_scale;
+   int j, k, bit;
+
+   switch (gen_p->seq) {
+      case QMC_MC:
+         key[0] = (uint32_t) gen_p->seed;
+         key[1] = (uint32_t) (gen_p->seed >> 32);
+         for (k = 0; k < count; k++) {
+            i = first + k;
+            ctr[0] = (uint32_t) i;
+            ctr[1] = (uint32_t) ((unsigned long long) i >> 32);
+            ctr[3] = 0;
+            for (j = 0; j < gen_p->dims; j += 2) {
+               ctr[2] = (uint32_t) j;
+               Philox4x32(ctr, key, out);
+               /* 53 random bits from each pair of outputs */
+               u = ((out[0] >> 5)*67108864.0 + (out[1] >> 6))
+                  *(1.0/9007199254740992.0);
+               x[j][k] = gen_p->a + scale*u;
+               if (j+1 < gen_p->dims) {
+                  u = ((out[2] >> 5)*67108864.0 + (out[3] >> 6))
+                     *(1.0/9007199254740992.0);
+                  x[j+1][k] = gen_p->a + scale*u;
+               }
+            }
+         }
+         break;
+      case QMC_HALTON:
+         for (j = 0; j < gen_p->dims; j++)
+            for (k = 0; k < count; k++) {
+               i = first + k + 1;
+               u = 0.0;
+               inv = 1.0/primes[j];
+               digit_scale = inv;
+               while (i > 0) {
+                  u += (i % primes[j])*digit_scale;
+                  i /= primes[j];
+                  digit_scale *= inv;
+               }
+               x[j][k] = gen_p->a + scale*u;
+            }
+         break;
+      default:   /* QMC_SOBOL */
+         /* Build point first directly from its Gray code, then step
+          * through the rest changing one direction number each */
+         gray = (uint32_t) (first ^ (first >> 1));
+         for (j = 0; j < gen_p->dims; j++) {
+            state[j] = 0;
+            for (bit = 0; bit < 32; bit++)
+               if ((gray >> bit) & 1) state[j] ^= gen_p->v[j][bit];
+         }
+         for (k = 0; k < count; k++) {
+            if (k > 0) {
+               i = first + k;
+               for (bit = 0; !((i >> bit) & 1); bit++)
+                  ;
+               for (j = 0; j < gen_p->dims; j++)
+                  state[j] ^= gen_p->v[j][bit];
+            }
+            for (j = 0; j < gen_p->dims; j++)
+               x[j][k] = gen_p->a + scale*(state[j]*(1.0/4294967296.0));
+         }
+         break;
+   }
+}  /* Qmc_points */
+
+/*------------------------------------------------------------------
+ * Function:    Qmc_sum
+ * Purpose:     Add f and f^2 over the points first <= i < last
+ * Out args:    sum_p, sumsq_p (incremented)
+ */
+static inline void Qmc_sum(const qmc_integrand_t* f_p,
+      const qmc_gen_t* gen_p, long long first, long long last,
+      double* sum_p, double* sumsq_p) {
+   double x[QMC_MAX_DIMS][QMC_BLOCK];
+   long long i;
+   int count;
+
+   /* The block kernels evaluate all QMC_BLOCK points, so a short last
+    * block mustn't leave garbage in x */
+   memset(x, 0, sizeof(x));
+   for (i = first; i < last; i += QMC_BLOCK) {
+      count = last - i < QMC_BLOCK ? (int) (last - i) : QMC_BLOCK;
+      Qmc_points(gen_p, i, count, x);
+      f_p->block(x, gen_p->dims, count, sum_p, sumsq_p);
+   }
+}  /* Qmc_sum */
+
+/*------------------------------------------------------------------
+ * Function:    Read_qmc_input
+ * Purpose:     Read d, a, b and the number of samples from stdin
+ * Return val:  0 on success, -1 on bad input, or more samples than
+ *              the sequence seq has (QMC_SOBOL_MAX for sobol)
+ */
+static inline int Read_qmc_input(qmc_seq_t seq, int* dims_p, double* a_p,
+      double* b_p, long long* samples_p) {
+   printf("Enter d, a, b, and the number of samples\n");
+   if (scanf("%d %lf %lf %lld", dims_p, a_p, b_p, samples_p) != 4
+         || *dims_p < 1 || *dims_p > QMC_MAX_DIMS || *samples_p < 1)
+      return -1;
+   if (seq == QMC_SOBOL && *samples_p > QMC_SOBOL_MAX) {
+      fprintf(stderr, "sobol has only %lld points\n", QMC_SOBOL_MAX);
+      return -1;
+   }
+   return 0;
+}  /* Read_qmc_input */
+
+/*------------------------------------------------------------------
+ * Function:    Print_qmc_result
+ * Purpose:     Turn the sums over all samples into the estimate
+ *              vol*mean and print it, with the standard error for mc
+ */
+static inline void Print_qmc_result(const qmc_integrand_t* f_p,
+      const qmc_gen_t* gen_p, long long samples, double sum,
+      double sumsq) {
+   double vol = pow(gen_p->b - gen_p->a, gen_p->dims);
+   double mean = sum/samples;
+   double var = sumsq/samples - mean*mean;
+
+   printf("With %lld %s samples, our estimate\n", samples,
+         qmc_seq_names[gen_p->seq]);
+   printf("of the integral of %s over [%f, %f]^%d = %.15e\n",
+         f_p->formula, gen_p->a, gen_p->b, gen_p->dims, vol*mean);
+   if (gen_p->seq == QMC_MC)
+      printf("standard error %e\n",
+            vol*sqrt((var > 0.0 ? var : 0.0)/samples));
+}  /* Print_qmc_result */
+
+#endif
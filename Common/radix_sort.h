@@ -0,0 +1,234 @@
+/* File:     radix_sort.h
+ * Purpose:  The steps of a parallel LSD radix sort of ints, shared by
+ *           the odd-even sort programs.
+ *
+ *           Keys are sorted as the unsigned offsets key - min, so only
+ *           the bits that the range of the keys actually uses are
+ *           sorted on, and negative keys need no special case.
+ *
+ *           If the range is under RADIX_COUNT_MAX values the list is
+ *           counting sorted: each thread counts the keys of its block
+ *           in a histogram with a bin per value.  A prefix sum over the
+ *           histograms then tells each thread where a share of the
+ *           values goes, and the thread writes those values straight
+ *           into the list.  There is one read pass and one write pass.
+ *
+ *           Otherwise the offsets are sorted a digit of up to
+ *           RADIX_BITS bits at a time, least significant first.  Each
+ *           pass goes through these steps:
+ *              - Each thread builds a histogram of its block's digits.
+ *              - A prefix sum over the p histograms gives every
+ *                (thread, digit) pair its place in the other list.
+ *              - Each thread scatters its keys there.  The keys are
+ *                staged in a cache line sized, line aligned buffer
+ *                per digit, and each buffer is written out when it
+ *                fills.  A digit's first flush is cut short where its
+ *                place in the other list reaches a line boundary, so
+ *                every later flush writes exactly one whole line.
+ *           The buffers turn 2^bits scattered write streams into whole
+ *           line writes.  Threads place their keys in rank order, so
+ *           every pass is stable.
+ *
+ * Usage:    in thread my_rank, with barriers between the steps:
+ *           Radix_min_max(my_keys, my_n, &mins[my_rank], &maxs[my_rank]);
+ *           Radix_plan(mins, maxs, p, &plan);
+ *           if plan.passes == 0:
+ *              Radix_histogram(&plan, 0, my_keys, my_n, hist + my_rank*B);
+ *              Radix_fill(&plan, hist, p, my_rank, list);
+ *           else for pass = 0, 1, ..., plan.passes-1:
+ *              Radix_histogram(&plan, pass, my_src, my_n, hist + my_rank*B);
+ *              Radix_offsets(hist, p, plan.buckets, my_rank, my_offsets);
+ *              Radix_scatter(&plan, pass, my_src, my_n, my_offsets, wc, dst);
+ *              swap src and dst
+ *           where B = plan.buckets, and wc holds Radix_wc_size(&plan)
+ *           ints private to the thread
+ */
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <string.h>
+#include <stdint.h>
+
+#define RADIX_BITS      11         /* Most bits sorted in one pass      */
+#define RADIX_COUNT_MAX (1 << 16)  /* Smaller ranges are counting sorted */
+#define RADIX_WC        16         /* Keys in a write combining buffer  */
+#define RADIX_LINE      (RADIX_WC*sizeof(int))   /* = a cache line     */
+
+typedef struct {
+   int      min;       /* smallest key                                */
+   int      passes;    /* digit passes, or 0 for a counting sort      */
+   int      bits;      /* bits in a digit                             */
+   int      buckets;   /* bins in a histogram                         */
+} radix_plan_t;
+
+/*------------------------------------------------------------------
+ * Function:    Radix_min_max
+ * Purpose:     Smallest and largest of the n > 0 keys
+ */
+static inline void Radix_min_max(const int keys[], int n, int* min_p,
+      int* max_p) {
+   int min = keys[0], max = keys[0], i;
+
+   for (i = 1; i < n; i++) {
+      if (keys[i] < min) min = keys[i];
+      if (keys[i] > max) max = keys[i];
+   }
+   *min_p = min;
+   *max_p = max;
+}  /* Radix_min_max */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_plan
+ * Purpose:     Choose a counting sort or the digit passes from the
+ *              p threads' minima and maxima
+ * Out arg:     plan
+ */
+static inline void Radix_plan(const int mins[], const int maxs[], int p,
+      radix_plan_t* plan) {
+   int min = mins[0], max = maxs[0], i, range_bits;
+   unsigned range;
+
+   for (i = 1; i < p; i++) {
+      if (mins[i] < min) min = mins[i];
+      if (maxs[i] > max) max = maxs[i];
+   }
+   range = (unsigned) max - (unsigned) min;
+
+   plan->min = min;
+   if (range < RADIX_COUNT_MAX) {
+      plan->passes = 0;
+      plan->bits = 0;
+      plan->buckets = (int) range + 1;
+   } else {
+      for (range_bits = 0; range_bits < 32 && (range >> range_bits) != 0;
+            range_bits++)
+         ;
+      /* Split the bits evenly over the fewest passes */
+      plan->passes = (range_bits + RADIX_BITS - 1)/RADIX_BITS;
+      plan->bits = (range_bits + plan->passes - 1)/plan->passes;
+      plan->buckets = 1 << plan->bits;
+   }
+}  /* Radix_plan */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_digit
+ * Purpose:     Bin of key in the histogram of pass pass
+ */
+static inline int Radix_digit(const radix_plan_t* plan, int pass, int key) {
+   unsigned offset = (unsigned) key - (unsigned) plan->min;
+
+   if (plan->passes == 0) return (int) offset;
+   return (int) ((offset >> (pass*plan->bits)) & (plan->buckets - 1));
+}  /* Radix_digit */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_wc_size
+ * Purpose:     Ints needed for a thread's write combining buffers,
+ *              their fill counts and limits, and a line of slack so
+ *              Radix_scatter can align the buffers
+ */
+static inline int Radix_wc_size(const radix_plan_t* plan) {
+   return plan->passes == 0 ? 0 : plan->buckets*(RADIX_WC + 2) + RADIX_WC;
+}  /* Radix_wc_size */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_histogram
+ * Purpose:     Count the keys of a block in each bin of pass pass
+ * Out arg:     hist
+ */
+static inline void Radix_histogram(const radix_plan_t* plan, int pass,
+      const int keys[], int n, int hist[]) {
+   int i;
+
+   memset(hist, 0, plan->buckets*sizeof(int));
+   for (i = 0; i < n; i++)
+      hist[Radix_digit(plan, pass, keys[i])]++;
+}  /* Radix_histogram */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_offsets
+ * Purpose:     Where thread my_rank's keys with each digit go: after
+ *              all the keys with smaller digits, and after the keys
+ *              with the same digit from the threads before it
+ * In args:     hist:  row i holds thread i's histogram
+ * Out arg:     offsets
+ */
+static inline void Radix_offsets(const int hist[], int p, int buckets,
+      int my_rank, int offsets[]) {
+   int first = 0, d, i;
+
+   for (d = 0; d < buckets; d++) {
+      offsets[d] = first;
+      for (i = 0; i < p; i++) {
+         if (i < my_rank) offsets[d] += hist[i*buckets + d];
+         first += hist[i*buckets + d];
+      }
+   }
+}  /* Radix_offsets */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_scatter
+ * Purpose:     Copy the keys of a block to their places in dst for
+ *              pass pass, RADIX_WC keys at a time
+ * In/out arg:  offsets:  from Radix_offsets, advanced past the keys
+ * Scratch:     wc:  Radix_wc_size(plan) ints, needn't be aligned
+ * Out arg:     dst
+ */
+static inline void Radix_scatter(const radix_plan_t* plan, int pass,
+      const int keys[], int n, int offsets[], int wc[], int dst[]) {
+   int* buf = (int*) (((uintptr_t) wc + RADIX_LINE - 1)
+         & ~(uintptr_t) (RADIX_LINE - 1));
+   int* fill = buf + plan->buckets*RADIX_WC;
+   int* limit = fill + plan->buckets;   /* keys to the next flush */
+   int i, d;
+
+   for (d = 0; d < plan->buckets; d++) {
+      fill[d] = 0;
+      limit[d] = RADIX_WC - (int) (((uintptr_t) (dst + offsets[d])
+            % RADIX_LINE)/sizeof(int));
+   }
+   for (i = 0; i < n; i++) {
+      d = Radix_digit(plan, pass, keys[i]);
+      buf[d*RADIX_WC + fill[d]++] = keys[i];
+      if (fill[d] == limit[d]) {
+         memcpy(dst + offsets[d], buf + d*RADIX_WC, fill[d]*sizeof(int));
+         offsets[d] += fill[d];
+         fill[d] = 0;
+         limit[d] = RADIX_WC;
+      }
+   }
+   for (d = 0; d < plan->buckets; d++) {
+      memcpy(dst + offsets[d], buf + d*RADIX_WC, fill[d]*sizeof(int));
+      offsets[d] += fill[d];
+   }
+}  /* Radix_scatter */
+
+/*------------------------------------------------------------------
+ * Function:    Radix_fill
+ * Purpose:     Counting sort: write thread my_rank's share of the key
+ *              values, as often as the histograms counted them, to
+ *              their place in the list
+ * In args:     hist:  row i holds thread i's histogram
+ * Out arg:     list
+ */
+static inline void Radix_fill(const radix_plan_t* plan, const int hist[],
+      int p, int my_rank, int list[]) {
+   int v_first = (int) ((long long) my_rank*plan->buckets/p);
+   int v_last = (int) ((long long) (my_rank + 1)*plan->buckets/p);
+   int pos = 0, v, i, count, key;
+
+   for (i = 0; i < p; i++)
+      for (v = 0; v < v_first; v++)
+         pos += hist[i*plan->buckets + v];
+   for (v = v_first; v < v_last; v++) {
+      count = 0;
+      for (i = 0; i < p; i++)
+         count += hist[i*plan->buckets + v];
+      key = (int) ((unsigned) plan->min + (unsigned) v);
+      for (i = 0; i < count; i++)
+         list[pos + i] = key;
+      pos += count;
+   }
+}  /* Radix_fill */
+
+#endif
@@ -0,0 +1,71 @@
+/* File:     repro.h
+ * Purpose:  Reproducible trapezoidal rule: the same a, b, n and
+ *           kernel give the same bits for any number of threads or
+ *           processes.
+ *
+ *           The n trapezoids are cut into a fixed set of leaves whose
+ *           boundaries depend only on n.  Each leaf is summed serially,
+ *           always starting from a with abscissae a + i*h, and the leaf
+ *           values are added by a fixed pairwise tree.  Threads and
+ *           processes only decide who computes which leaves, never the
+ *           order of any addition.
+ *
+ * Note:     The kernels for different ISAs round differently, so use the
+ *           same -isa (e.g. generic) to compare results across machines.
+ */
+#ifndef REPRO_H
+#define REPRO_H
+
+#include "integrands.h"
+
+/* Number of leaves when n is at least this large */
+#define REPRO_LEAVES 1024
+
+/*------------------------------------------------------------------
+ * Function:    Repro_leaf_count
+ * Purpose:     Number of leaves used for n trapezoids
+ */
+static inline int Repro_leaf_count(int n) {
+   return n < REPRO_LEAVES ? n : REPRO_LEAVES;
+}  /* Repro_leaf_count */
+
+/*------------------------------------------------------------------
+ * Function:    Repro_first
+ * Purpose:     Index of the first of the total items that belong to
+ *              part i of parts.  Part i owns Repro_first(i) <= item <
+ *              Repro_first(i+1), and the parts differ in size by at
+ *              most one.  This is floor(i*total/parts), computed
+ *              without overflow for any long long total.
+ */
+static inline long long Repro_first(long long total, int parts, int i) {
+   return total/parts*i + total%parts*i/parts;
+}  /* Repro_first */
+
+/*------------------------------------------------------------------
+ * Function:    Repro_leaf
+ * Purpose:     Trapezoidal rule over leaf j of leaf_count leaves of the
+ *              n trapezoids of width h starting at a
+ */
+static inline double Repro_leaf(const integrand_t* integrand, double a,
+      double h, int n, int leaf_count, int j) {
+   int lo = Repro_first(n, leaf_count, j);
+   int hi = Repro_first(n, leaf_count, j+1);
+   double estimate;
+
+   estimate = (integrand->f(a + lo*h) + integrand->f(a + hi*h))/2.0;
+   estimate += integrand->sum(a, h, lo+1, hi-1);
+   return estimate*h;
+}  /* Repro_leaf */
+
+/*------------------------------------------------------------------
+ * Function:    Pairwise_sum
+ * Purpose:     Add count values by always splitting the list in half
+ */
+static inline double Pairwise_sum(const double v[], int count) {
+   if (count <= 0) return 0.0;
+   if (count == 1) return v[0];
+   return Pairwise_sum(v, count/2) + Pairwise_sum(v + count/2,
+         count - count/2);
+}  /* Pairwise_sum */
+
+#endif
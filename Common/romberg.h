@@ -0,0 +1,111 @@
+/* File:     romberg.h
+ * Purpose:  Romberg integration built on incremental trapezoidal sums.
+ *
+ *           Level 0 is the trapezoidal rule with n trapezoids.  Level k
+ *           halves the trapezoids of level k-1, so only the n*2^(k-1)
+ *           new midpoints have to be evaluated:
+ *
+ *              S_k = S_(k-1) + sum of f(new midpoints)
+ *              T_k = h_k*S_k,   h_k = (b-a)/(n*2^k)
+ *
+ *           where S_0 = (f(a) + f(b))/2 + sum of f at the interior
+ *           points.  Richardson extrapolation of T_0, ..., T_k gives
+ *           R[k][k], which has error O(h_k^(2k+2)) for smooth f.
+ *
+ * Usage:    romberg_t r;
+ *           Romberg_init(&r, a, b, n, levels);
+ *           Romberg_add(&r, S_0);
+ *           while (Romberg_next(&r, &x0, &step, &count))
+ *              Romberg_add(&r, sum of f(x0 + i*step), 0 <= i < count);
+ *           Romberg_print(&r, stdout);
+ */
+#ifndef ROMBERG_H
+#define ROMBERG_H
+
+#include <stdio.h>
+#include <limits.h>
+
+#define ROMBERG_MAX_LEVELS 30
+
+typedef struct {
+   double a, b;
+   int    n;          /* trapezoids at level 0             */
+   int    levels;     /* last level to compute             */
+   int    level;      /* levels done so far - 1            */
+   double sum;        /* S_level                           */
+   double R[ROMBERG_MAX_LEVELS+1][ROMBERG_MAX_LEVELS+1];
+} romberg_t;
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_init
+ * Purpose:     Start a table for [a, b] from n trapezoids, with levels
+ *              halvings.  levels is reduced if n*2^levels would
+ *              overflow an int or it exceeds ROMBERG_MAX_LEVELS.
+ */
+static inline void Romberg_init(romberg_t* r_p, double a, double b,
+      int n, int levels) {
+   r_p->a = a;
+   r_p->b = b;
+   r_p->n = n;
+   if (levels > ROMBERG_MAX_LEVELS) levels = ROMBERG_MAX_LEVELS;
+   while (levels > 0 && n > (INT_MAX >> levels)) levels--;
+   r_p->levels = levels;
+   r_p->level = -1;
+   r_p->sum = 0.0;
+}  /* Romberg_init */
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_next
+ * Purpose:     Find the new points of the next level
+ * Output args: x0_p, step_p, count_p:  the points are x0 + i*step,
+ *              0 <= i < count
+ * Return val:  0 if all the levels have been done
+ */
+static inline int Romberg_next(const romberg_t* r_p, double* x0_p,
+      double* step_p, int* count_p) {
+   int k = r_p->level + 1;
+   double h;
+
+   if (k > r_p->levels) return 0;
+   h = (r_p->b - r_p->a)/((double) r_p->n*(1 << k));
+   *count_p = r_p->n << (k-1);
+   *x0_p = r_p->a + h;
+   *step_p = 2.0*h;
+   return 1;
+}  /* Romberg_next */
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_add
+ * Purpose:     Add the next level: sum is S_0 for level 0, and the sum
+ *              of f over the points given by Romberg_next after that
+ */
+static inline void Romberg_add(romberg_t* r_p, double sum) {
+   int k = ++r_p->level;
+   int j;
+   double h = (r_p->b - r_p->a)/((double) r_p->n*(1 << k));
+   double factor = 1.0;
+
+   r_p->sum += sum;
+   r_p->R[k][0] = h*r_p->sum;
+   for (j = 1; j <= k; j++) {
+      factor *= 4.0;
+      r_p->R[k][j] = r_p->R[k][j-1]
+         + (r_p->R[k][j-1] - r_p->R[k-1][j-1])/(factor - 1.0);
+   }
+}  /* Romberg_add */
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_print
+ * Purpose:     Print the trapezoidal and extrapolated estimate of each
+ *              level done
+ */
+static inline void Romberg_print(const romberg_t* r_p, FILE* fp) {
+   int k;
+
+   fprintf(fp, "%12s %24s %24s\n", "n", "trapezoid", "Romberg");
+   for (k = 0; k <= r_p->level; k++)
+      fprintf(fp, "%12d %24.15e %24.15e\n", r_p->n << k, r_p->R[k][0],
+            r_p->R[k][k]);
+}  /* Romberg_print */
+
+#endif
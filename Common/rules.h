@@ -0,0 +1,141 @@
+/* File:     rules.h
+ * Purpose:  Higher order composite quadrature rules for the
+ *           trapezoidal rule programs: Simpson, Boole and m-point
+ *           Gauss-Legendre, selected with -rule.
+ *
+ *           [a, b] is cut into n panels of width H = (b-a)/n and each
+ *           rule is a fixed set of nodes a + (p + t_j)*H in panel p
+ *           with weights w_j*H.  For a fixed node j the nodes of all
+ *           the panels are evenly spaced, H apart, so
+ *
+ *              sum over panels p of f(a + (p + t_j)*H)
+ *
+ *           is exactly what an integrand's vectorized inner loop
+ *           (integrand->sum, see trap_isa.h) computes.  A rule over a
+ *           block of panels is then one call of that loop per node,
+ *           plus one for the panel ends shared by neighbouring panels
+ *           (Simpson and Boole), and the programs split the panels
+ *           among their threads or processes just as they split the
+ *           trapezoids.
+ *
+ *           Error per unit length, for smooth f:
+ *
+ *              simpson   O(H^4)   2 evaluations of f per panel
+ *              boole     O(H^6)   4
+ *              glm       O(H^2m)  m   (m = 2, 3, 4, 5)
+ *
+ * Usage:    #include "../Common/rules.h"
+ *           const quad_rule_t* rule = Find_rule("gl4");
+ *           sum = Rule_sum(rule, f, a, (b-a)/n, 0, n);
+ */
+#ifndef RULES_H
+#define RULES_H
+
+#include <stdio.h>
+#include <string.h>
+#include "integrands.h"
+
+#define RULE_MAX_NODES 5
+
+typedef struct {
+   const char* name;
+   const char* description;
+   double      end_weight;          /* weight of each panel end      */
+   int         nodes;               /* nodes inside a panel          */
+   double      t[RULE_MAX_NODES];   /* their offsets, 0 < t < 1      */
+   double      w[RULE_MAX_NODES];   /* and weights; all add up to 1  */
+} quad_rule_t;
+
+/* Gauss-Legendre nodes x and weights v on [-1, 1] become
+ * t = (1 + x)/2 and w = v/2 on [0, 1] */
+#define GL_NODE(x) (0.5 + 0.5*(x))
+
+static const quad_rule_t quad_rules[] = {
+   {"simpson", "composite Simpson, 1/6 4/6 1/6",
+      1.0/6.0, 1, {0.5}, {4.0/6.0}},
+   {"boole", "composite Boole, 7 32 12 32 7 (/90)",
+      7.0/90.0, 3, {0.25, 0.5, 0.75}, {32.0/90.0, 12.0/90.0, 32.0/90.0}},
+   {"gl2", "2-point Gauss-Legendre", 0.0, 2,
+      {GL_NODE(-0.57735026918962576451), GL_NODE(0.57735026918962576451)},
+      {0.5, 0.5}},
+   {"gl3", "3-point Gauss-Legendre", 0.0, 3,
+      {GL_NODE(-0.77459666924148337704), 0.5,
+       GL_NODE(0.77459666924148337704)},
+      {5.0/18.0, 8.0/18.0, 5.0/18.0}},
+   {"gl4", "4-point Gauss-Legendre", 0.0, 4,
+      {GL_NODE(-0.86113631159405257522), GL_NODE(-0.33998104358485626480),
+       GL_NODE(0.33998104358485626480), GL_NODE(0.86113631159405257522)},
+      {0.5*0.34785484513745385737, 0.5*0.65214515486254614263,
+       0.5*0.65214515486254614263, 0.5*0.34785484513745385737}},
+   {"gl5", "5-point Gauss-Legendre", 0.0, 5,
+      {GL_NODE(-0.90617984593866399280), GL_NODE(-0.53846931010568309104),
+       0.5,
+       GL_NODE(0.53846931010568309104), GL_NODE(0.90617984593866399280)},
+      {0.5*0.23692688505618908751, 0.5*0.47862867049936646804,
+       0.5*0.56888888888888888889,
+       0.5*0.47862867049936646804, 0.5*0.23692688505618908751}},
+};
+
+#define RULE_COUNT ((int) (sizeof(quad_rules)/sizeof(quad_rules[0])))
+
+/*------------------------------------------------------------------
+ * Function:    Find_rule
+ * Purpose:     Look up a rule by name
+ * Return val:  Pointer to the rule, or NULL if there is no rule with
+ *              that name
+ */
+static inline const quad_rule_t* Find_rule(const char* name) {
+   int i;
+
+   for (i = 0; i < RULE_COUNT; i++)
+      if (strcmp(quad_rules[i].name, name) == 0)
+         return &quad_rules[i];
+   return NULL;
+}  /* Find_rule */
+
+/*------------------------------------------------------------------
+ * Function:    List_rules
+ * Purpose:     Print the names of the known rules
+ */
+static inline void List_rules(FILE* fp) {
+   int i;
+
+   fprintf(fp, "Known rules (-rule):\n");
+   for (i = 0; i < RULE_COUNT; i++)
+      fprintf(fp, "   %-10s %s\n", quad_rules[i].name,
+            quad_rules[i].description);
+}  /* List_rules */
+
+/*------------------------------------------------------------------
+ * Function:    Rule_evals
+ * Purpose:     Evaluations of f per panel, not counting the last end
+ */
+static inline int Rule_evals(const quad_rule_t* rule) {
+   return rule->nodes + (rule->end_weight != 0.0);
+}  /* Rule_evals */
+
+/*------------------------------------------------------------------
+ * Function:    Rule_sum
+ * Purpose:     Apply rule to the panels first <= p < last of width H
+ *              starting at a
+ * Return val:  The integral from a + first*H to a + last*H, or 0 if
+ *              there are no panels
+ */
+static inline double Rule_sum(const quad_rule_t* rule,
+      const integrand_t* integrand, double a, double H, int first,
+      int last) {
+   double sum = 0.0;
+   int j;
+
+   if (last <= first) return 0.0;
+   if (rule->end_weight != 0.0)
+      sum = rule->end_weight*(integrand->f(a + first*H)
+            + integrand->f(a + last*H)
+            + 2.0*integrand->sum(a, H, first + 1, last - 1));
+   for (j = 0; j < rule->nodes; j++)
+      sum += rule->w[j]*integrand->sum(a + rule->t[j]*H, H, first,
+            last - 1);
+   return sum*H;
+}  /* Rule_sum */
+
+#endif
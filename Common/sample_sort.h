@@ -0,0 +1,146 @@
+/* File:     sample_sort.h
+ * Purpose:  The bucketing steps of a parallel sample sort of ints,
+ *           shared by the odd-even sort programs.
+ *
+ *           Each of p threads owns a block of the list.  Every thread
+ *           picks SAMPLE_OVERSAMPLE keys from its block; the p*s
+ *           samples are sorted and every s-th one becomes a splitter.
+ *           The p-1 splitters cut the keys into p buckets of about n/p
+ *           keys each.  Each thread counts how many of its keys fall in
+ *           each bucket, a prefix sum of the p x p counts gives every
+ *           (thread, bucket) pair its place in a second list, and each
+ *           thread scatters its keys there in one pass.  Thread j then
+ *           sorts bucket j, which is already in its final place.
+ *
+ *           A key is copied twice (out to the buckets and back), and
+ *           the work is O(n/p log n) per thread, however many threads
+ *           there are.
+ *
+ * Usage:    in thread my_rank, with barriers between the steps:
+ *           Sample_pick(my_keys, my_n, samples + my_rank*SAMPLE_OVERSAMPLE);
+ *           one thread:  qsort(samples, p*SAMPLE_OVERSAMPLE, ...);
+ *                        Sample_splitters(samples, p, splitters);
+ *           Sample_count(my_keys, my_n, splitters, p, my_counts);
+ *           copy my_counts to row my_rank of counts
+ *           Sample_offsets(counts, p, my_rank, my_offsets);
+ *           Sample_scatter(my_keys, my_n, splitters, p, my_offsets, temp);
+ *           sort bucket my_rank of temp, from Sample_bucket_first(counts,
+ *           p, my_rank) to Sample_bucket_first(counts, p, my_rank+1)
+ *
+ * Note:     my_counts and my_offsets should be private to the thread:
+ *           the counts change once per key, and neighbouring rows of
+ *           counts share cache lines.
+ */
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+#define SAMPLE_OVERSAMPLE 64   /* Samples taken from each block */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_pick
+ * Purpose:     Take SAMPLE_OVERSAMPLE evenly spaced keys from a block
+ * In args:     keys, n (> 0)
+ * Out arg:     samples
+ */
+static inline void Sample_pick(const int keys[], int n, int samples[]) {
+   int k;
+
+   for (k = 0; k < SAMPLE_OVERSAMPLE; k++)
+      samples[k] = keys[(2LL*k + 1)*n/(2*SAMPLE_OVERSAMPLE)];
+}  /* Sample_pick */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_splitters
+ * Purpose:     Choose the p-1 splitters from the p*SAMPLE_OVERSAMPLE
+ *              sorted samples
+ * Out arg:     splitters
+ */
+static inline void Sample_splitters(const int samples[], int p,
+      int splitters[]) {
+   int j;
+
+   for (j = 1; j < p; j++)
+      splitters[j-1] = samples[j*SAMPLE_OVERSAMPLE];
+}  /* Sample_splitters */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_bucket
+ * Purpose:     Bucket of key: the number of splitters <= key
+ */
+static inline int Sample_bucket(int key, const int splitters[], int p) {
+   int lo = 0, hi = p-1, mid;
+
+   while (lo < hi) {
+      mid = (lo + hi)/2;
+      if (splitters[mid] <= key)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}  /* Sample_bucket */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_count
+ * Purpose:     Count the keys of a block in each of the p buckets
+ * Out arg:     counts
+ */
+static inline void Sample_count(const int keys[], int n,
+      const int splitters[], int p, int counts[]) {
+   int i;
+
+   for (i = 0; i < p; i++)
+      counts[i] = 0;
+   for (i = 0; i < n; i++)
+      counts[Sample_bucket(keys[i], splitters, p)]++;
+}  /* Sample_count */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_bucket_first
+ * Purpose:     Index of the first key of bucket j, given the counts of
+ *              all the threads (row i holds thread i's)
+ */
+static inline int Sample_bucket_first(const int counts[], int p, int j) {
+   int first = 0, i, k;
+
+   for (i = 0; i < p; i++)
+      for (k = 0; k < j; k++)
+         first += counts[i*p + k];
+   return first;
+}  /* Sample_bucket_first */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_offsets
+ * Purpose:     Where thread my_rank's keys of each bucket go: after
+ *              the earlier buckets, and after the keys of the same
+ *              bucket from the threads before it
+ * Out arg:     offsets
+ */
+static inline void Sample_offsets(const int counts[], int p, int my_rank,
+      int offsets[]) {
+   int first = 0, i, j;
+
+   for (j = 0; j < p; j++) {
+      offsets[j] = first;
+      for (i = 0; i < p; i++) {
+         if (i < my_rank) offsets[j] += counts[i*p + j];
+         first += counts[i*p + j];
+      }
+   }
+}  /* Sample_offsets */
+
+/*------------------------------------------------------------------
+ * Function:    Sample_scatter
+ * Purpose:     Copy the keys of a block to their buckets in dst
+ * In/out arg:  offsets:  from Sample_offsets, advanced past the keys
+ * Out arg:     dst
+ */
+static inline void Sample_scatter(const int keys[], int n,
+      const int splitters[], int p, int offsets[], int dst[]) {
+   int i;
+
+   for (i = 0; i < n; i++)
+      dst[offsets[Sample_bucket(keys[i], splitters, p)]++] = keys[i];
+}  /* Sample_scatter */
+
+#endif
@@ -0,0 +1,194 @@
+/* File:     tabdata.h
+ * Purpose:  Trapezoidal rule over tabulated samples (x_i, y_i), e.g.
+ *           measured data, read straight from a memory mapped file.
+ *
+ * Input:    A binary file of samples, each two native doubles x_i, y_i
+ *           (TAB_SAMPLE bytes), in order of x.  The x_i needn't be
+ *           evenly spaced.  Such a file can be written with
+ *
+ *              fwrite(xy, sizeof(double), 2*samples, fp);
+ *
+ * Output:   The sum over 0 <= i < samples-1 of
+ *
+ *              (x_{i+1} - x_i)*(y_i + y_{i+1})/2
+ *
+ * Note:     The programs split the samples into contiguous slices, one
+ *           per thread or process, and integrate each slice where it
+ *           lies in the mapping, without copying it.  Threads share a
+ *           mapping of the whole file, so a thread's slice simply ends
+ *           on the first sample of the next slice.  MPI processes map
+ *           only their own slice, and the trapezoid between two slices
+ *           is stitched by passing each slice's first sample to the
+ *           process before it.
+ *
+ *           Pages are read in by the page faults of the integration,
+ *           so a file much larger than memory is streamed through once
+ *           at the speed of the disk.  On 32-bit POSIX systems compile
+ *           with -D_FILE_OFFSET_BITS=64 for files over 2GB.
+ */
+#ifndef TABDATA_H
+#define TABDATA_H
+
+#include <stdio.h>
+#include <stddef.h>
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define TAB_SAMPLE (2*sizeof(double))   /* Bytes in one (x, y) sample */
+
+/* A read only view of samples first, ..., first+count-1 of a file */
+typedef struct {
+   const double* xy;     /* x, y of sample first+i at xy[2*i], xy[2*i+1] */
+   long long     first;
+   long long     count;
+   void*         view;   /* the mapping, which starts on a page boundary */
+   size_t        view_len;
+} tab_map_t;
+
+/*------------------------------------------------------------------
+ * Function:    Tab_samples
+ * Purpose:     Number of samples in the file fname
+ * Return val:  The number of samples, or -1 (after printing a
+ *              message) if the file can't be opened or its size isn't
+ *              a whole number of samples, at least 2
+ */
+static inline long long Tab_samples(const char* fname) {
+   long long size;
+#ifdef _WIN32
+   HANDLE file;
+   LARGE_INTEGER file_size;
+
+   file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL,
+         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE) {
+      fprintf(stderr, "Can't open %s\n", fname);
+      return -1;
+   }
+   size = GetFileSizeEx(file, &file_size) ? file_size.QuadPart : -1;
+   CloseHandle(file);
+#else
+   struct stat st;
+
+   if (stat(fname, &st) != 0) {
+      fprintf(stderr, "Can't open %s\n", fname);
+      return -1;
+   }
+   size = st.st_size;
+#endif
+   if (size < (long long) (2*TAB_SAMPLE) || size % TAB_SAMPLE != 0) {
+      fprintf(stderr, "%s isn't a file of 2 or more (x, y) samples\n",
+            fname);
+      return -1;
+   }
+   return size/(long long) TAB_SAMPLE;
+}  /* Tab_samples */
+
+/*------------------------------------------------------------------
+ * Function:    Tab_map
+ * Purpose:     Map samples first, ..., first+count-1 of the file
+ *              fname.  Only their pages are mapped, from the page
+ *              boundary at or before the first one.
+ * Output args: map_p
+ * Return val:  0 on success, -1 (after printing a message) on failure
+ */
+static inline int Tab_map(const char* fname, long long first,
+      long long count, tab_map_t* map_p) {
+   long long beg = first*(long long) TAB_SAMPLE, aligned;
+#ifdef _WIN32
+   HANDLE file, mapping;
+   SYSTEM_INFO info;
+
+   /* Views must start on the allocation granularity, not the page */
+   GetSystemInfo(&info);
+   aligned = beg - beg % info.dwAllocationGranularity;
+#else
+   int fd;
+
+   aligned = beg - beg % sysconf(_SC_PAGESIZE);
+#endif
+   map_p->first = first;
+   map_p->count = count;
+   map_p->view = NULL;
+   map_p->view_len =
+      (size_t) (beg - aligned + count*(long long) TAB_SAMPLE);
+   map_p->xy = NULL;
+   if (count <= 0) return 0;
+
+#ifdef _WIN32
+   file = CreateFileA(fname, GENERIC_READ, FILE_SHARE_READ, NULL,
+         OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+   if (file != INVALID_HANDLE_VALUE) {
+      mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping != NULL) {
+         map_p->view = MapViewOfFile(mapping, FILE_MAP_READ,
+               (DWORD) (aligned >> 32), (DWORD) aligned, map_p->view_len);
+         /* The view keeps the mapping and the file open */
+         CloseHandle(mapping);
+      }
+      CloseHandle(file);
+   }
+#else
+   fd = open(fname, O_RDONLY);
+   if (fd >= 0) {
+      map_p->view = mmap(NULL, map_p->view_len, PROT_READ, MAP_SHARED,
+            fd, (off_t) aligned);
+      if (map_p->view == MAP_FAILED) map_p->view = NULL;
+      close(fd);
+   }
+#  ifdef MADV_SEQUENTIAL
+   if (map_p->view != NULL)
+      madvise(map_p->view, map_p->view_len, MADV_SEQUENTIAL);
+#  endif
+#endif
+   if (map_p->view == NULL) {
+      fprintf(stderr, "Can't map %s\n", fname);
+      return -1;
+   }
+   map_p->xy = (const double*) ((char*) map_p->view + (beg - aligned));
+   return 0;
+}  /* Tab_map */
+
+/*------------------------------------------------------------------
+ * Function:    Tab_unmap
+ */
+static inline void Tab_unmap(tab_map_t* map_p) {
+   if (map_p->view == NULL) return;
+#ifdef _WIN32
+   UnmapViewOfFile(map_p->view);
+#else
+   munmap(map_p->view, map_p->view_len);
+#endif
+   map_p->view = NULL;
+   map_p->xy = NULL;
+}  /* Tab_unmap */
+
+/*------------------------------------------------------------------
+ * Function:    Tab_trap
+ * Purpose:     Trapezoidal rule over the count-1 intervals between
+ *              the samples xy[0..2*count-1]
+ */
+static inline double Tab_trap(const double xy[], long long count) {
+   double sum = 0.0;
+   long long i;
+
+   for (i = 0; i < count - 1; i++)
+      sum += (xy[2*i+2] - xy[2*i])*(xy[2*i+1] + xy[2*i+3]);
+   return sum/2.0;
+}  /* Tab_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Print_tab_result
+ */
+static inline void Print_tab_result(const char* fname, long long samples,
+      double x0, double x1, double total) {
+   printf("With %lld samples from %s, our estimate\n", samples, fname);
+   printf("of the integral from %f to %f = %.15e\n", x0, x1, total);
+}  /* Print_tab_result */
+
+#endif
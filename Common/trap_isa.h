@@ -0,0 +1,114 @@
+/* File:     trap_isa.h
+ * Purpose:  Run time selection of the instruction set used by the
+ *           trapezoidal rule inner loops.
+ *
+ *           DEFINE_TRAP_SUM builds one inner loop for a given f.  The
+ *           loop keeps TRAP_LANES independent partial sums, so there
+ *           is no single chain of dependent floating point adds, and
+ *           the body over the lanes is a fixed-length loop the compiler
+ *           turns into 4-wide (AVX2) or 8-wide (AVX-512) vector code.
+ *           integrands.h compiles that loop once per ISA with the
+ *           matching target attribute, and Select_trap_isa picks the
+ *           best one the CPU supports at startup.
+ *
+ * Notes:
+ * 1.  The AVX2 and AVX-512 kernels are only built by gcc and clang on
+ *     x86.  Elsewhere every ISA maps to the generic kernel.
+ * 2.  Kernels for different ISAs may round differently (FMA
+ *     contraction), so results can differ in the last digits.
+ */
+#ifndef TRAP_ISA_H
+#define TRAP_ISA_H
+
+#include <string.h>
+
+/* Independent partial sums kept by every inner loop */
+#define TRAP_LANES 16
+
+typedef enum {
+   TRAP_ISA_GENERIC,
+   TRAP_ISA_AVX2,
+   TRAP_ISA_AVX512,
+   TRAP_ISA_COUNT,
+   TRAP_ISA_AUTO = -1
+} trap_isa_t;
+
+static const char* const trap_isa_names[TRAP_ISA_COUNT] =
+   {"generic", "avx2", "avx512"};
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  define TRAP_HAVE_X86_KERNELS 1
+#  define TRAP_TARGET_GENERIC
+#  define TRAP_TARGET_AVX2   __attribute__((target("avx2,fma")))
+#  define TRAP_TARGET_AVX512 \
+      __attribute__((target("avx512f,avx512dq,fma,prefer-vector-width=512")))
+#else
+#  define TRAP_HAVE_X86_KERNELS 0
+#  define TRAP_TARGET_GENERIC
+#endif
+
+/*------------------------------------------------------------------
+ * Macro:       DEFINE_TRAP_SUM
+ * Purpose:     Define kernel(x0, h, first, last), returning the sum of
+ *              fn(x0 + i*h) for first <= i <= last
+ * Args:        kernel:  name of the function to define
+ *              target:  one of the TRAP_TARGET_* attributes
+ *              fn:      function or macro evaluating the integrand;
+ *                       it should be inline so the lane loop vectorizes
+ */
+#define DEFINE_TRAP_SUM(kernel, target, fn)                          \
+   static target double kernel(double x0, double h, int first,       \
+         int last) {                                                 \
+      double acc[TRAP_LANES];                                        \
+      double sum = 0.0;                                              \
+      int i, l;                                                      \
+                                                                     \
+      for (l = 0; l < TRAP_LANES; l++)                               \
+         acc[l] = 0.0;                                               \
+      for (i = first; i <= last - (TRAP_LANES-1); i += TRAP_LANES)   \
+         for (l = 0; l < TRAP_LANES; l++)                            \
+            acc[l] += fn(x0 + (i+l)*h);                              \
+      for (; i <= last; i++)                                         \
+         sum += fn(x0 + i*h);                                        \
+      for (l = TRAP_LANES/2; l > 0; l /= 2)                          \
+         for (i = 0; i < l; i++)                                     \
+            acc[i] += acc[i+l];                                      \
+      return sum + acc[0];                                           \
+   }
+
+/*------------------------------------------------------------------
+ * Function:    Best_trap_isa
+ * Purpose:     Find the widest ISA both the CPU and the OS support
+ *              and that we have kernels for
+ */
+static inline trap_isa_t Best_trap_isa(void) {
+#if TRAP_HAVE_X86_KERNELS
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"))
+      return TRAP_ISA_AVX512;
+   if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+      return TRAP_ISA_AVX2;
+#endif
+   return TRAP_ISA_GENERIC;
+}  /* Best_trap_isa */
+
+/*------------------------------------------------------------------
+ * Function:    Find_trap_isa
+ * Purpose:     Convert an ISA name ("auto", "generic", "avx2",
+ *              "avx512") to a trap_isa_t
+ * Return val:  The ISA, or TRAP_ISA_COUNT if the name is unknown or
+ *              the CPU can't run that ISA
+ */
+static inline trap_isa_t Find_trap_isa(const char* name) {
+   int isa;
+
+   if (strcmp(name, "auto") == 0)
+      return TRAP_ISA_AUTO;
+   for (isa = 0; isa < TRAP_ISA_COUNT; isa++)
+      if (strcmp(name, trap_isa_names[isa]) == 0)
+         return isa <= (int) Best_trap_isa() ? (trap_isa_t) isa
+                                             : TRAP_ISA_COUNT;
+   return TRAP_ISA_COUNT;
+}  /* Find_trap_isa */
+
+#endif
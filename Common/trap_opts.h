@@ -0,0 +1,350 @@
+/* File:     trap_opts.h
+ * Purpose:  Command line options shared by the trapezoidal rule
+ *           programs.
+ *
+ * Options:  -f <name>   integrand to use (default DEFAULT_INTEGRAND)
+ *           -expr <expression>
+ *                       integrate an expression in x instead of a
+ *                       known integrand, e.g. "exp(-x*x)*cos(3*x)"
+ *                       (see expr.h)
+ *           -l          list the known integrands and quit
+ *           -isa <isa>  inner loop kernel: auto (default), generic,
+ *                       avx2 or avx512
+ *           -adapt <tol>
+ *                       adaptive Simpson to absolute error tol
+ *                       instead of the trapezoidal rule; n is then
+ *                       the number of panels to start from
+ *           -rule <rule>
+ *                       integrate n panels of a higher order rule:
+ *                       simpson, boole or gl2, ..., gl5 (Gauss-
+ *                       Legendre, see rules.h) instead of n
+ *                       trapezoids
+ *           -repro      sum in a fixed order (see repro.h), so the
+ *                       result doesn't depend on the number of
+ *                       threads or processes
+ *           -romberg <levels>
+ *                       halve the trapezoids levels times, reusing
+ *                       the sums of earlier levels, and extrapolate
+ *                       (see romberg.h)
+ *           -cub <name> integrate the 2D or 3D integrand name over a
+ *                       box (see cubature.h); reads a, b for each
+ *                       axis and then n
+ *           -batch <file>
+ *                       compute every job in file (see batch.h)
+ *                       instead of reading a, b and n
+ *           -qmc <name> integrate the d-dimensional integrand name
+ *                       over [a, b]^d by (quasi-)Monte Carlo (see
+ *                       qmc.h); reads d, a, b and the number of samples
+ *           -seq <seq>  sample sequence for -qmc: mc, halton or
+ *                       sobol (default)
+ *           -seed <s>   seed of the mc sequence (default 1)
+ *           -cumul <file>
+ *                       write the cumulative integral F(x) at the grid
+ *                       points to file (see cumul.h)
+ *           -every <k>  with -cumul, only every k-th grid point
+ *           -cache <file>
+ *                       reuse results and block sums of earlier runs
+ *                       kept in file, and add this run's (see cache.h);
+ *                       for the trapezoidal rule and -rule only
+ *           -tab <file> integrate the (x, y) samples in the binary
+ *                       file (see tabdata.h) instead of reading a, b
+ *                       and n
+ *
+ *           Only for MPI/mpi_trap4.c (which defines TRAP_OPTS_MPI):
+ *           -hybrid     split each process' trapezoids among its
+ *                       OpenMP threads and reduce within each node
+ *                       before reducing across nodes
+ *           -stream <file>
+ *                       compute the jobs in file one after another,
+ *                       each split across all the processes, with the
+ *                       reduction of one job overlapping the next
+ *           -reduce <strategy>
+ *                       how the processes' sums reach process 0:
+ *                       flat (MPI_Reduce, the default), node (within
+ *                       each node, then across the node leaders; the
+ *                       default with -hybrid), rma (MPI_Accumulate
+ *                       into a window on process 0), or all (time
+ *                       every strategy and print a table)
+ *           -dynamic <scheme>
+ *                       hand out chunks of the trapezoids (or panels)
+ *                       on demand: rma (each process takes the next
+ *                       chunk with MPI_Fetch_and_op on a counter) or
+ *                       master (process 0 hands out the chunks and
+ *                       computes none of them)
+ *           -chunk <k>  trapezoids per chunk with -dynamic (default
+ *                       n/(DYNAMIC_CHUNKS*comm_sz))
+ *
+ * Usage:    #include "../Common/trap_opts.h"
+ *           if (Get_trap_opts(argc, argv, first, &opts, 1) != 0) ...
+ */
+#ifndef TRAP_OPTS_H
+#define TRAP_OPTS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "integrands.h"
+#include "cubature.h"
+#include "qmc.h"
+#include "rules.h"
+#include "expr.h"
+
+#ifdef TRAP_OPTS_MPI
+/* Reduction strategies of mpi_trap4 */
+typedef enum {
+   REDUCE_FLAT,
+   REDUCE_NODE,
+   REDUCE_RMA,
+   REDUCE_ALL,
+   REDUCE_COUNT
+} reduce_t;
+
+static const char* const reduce_names[REDUCE_COUNT] =
+   {"flat", "node", "rma", "all"};
+
+/* Schemes for handing out chunks with -dynamic */
+typedef enum {
+   DYNAMIC_RMA,
+   DYNAMIC_MASTER,
+   DYNAMIC_COUNT
+} dynamic_t;
+
+static const char* const dynamic_names[DYNAMIC_COUNT] =
+   {"rma", "master"};
+
+#define DYNAMIC_CHUNKS 16   /* Default chunks per process */
+#endif
+
+typedef struct {
+   const integrand_t* integrand;
+   const quad_rule_t* rule;  /* panel rule, or NULL for trapezoids */
+   trap_isa_t         isa;   /* kernel selected for integrand->sum */
+   double             tol;   /* > 0: adaptive Simpson to this error */
+   int                repro; /* reproducible sum                    */
+   int                romberg;/* > 0: Romberg with this many levels */
+   const char*        batch; /* batch file, or NULL                 */
+   const cub_integrand_t* cub; /* 2D/3D integrand, or NULL          */
+   int                hybrid;/* MPI + OpenMP                        */
+   const char*        stream;/* job file for streaming mode, or NULL */
+   int                reduce;/* reduce_t, or -1 for the default     */
+   int                dynamic;/* dynamic_t, or -1 for static blocks */
+   int                chunk; /* trapezoids per chunk, or 0: default */
+   const qmc_integrand_t* qmc; /* d-dimensional integrand, or NULL  */
+   qmc_seq_t          seq;   /* sample sequence for qmc             */
+   uint64_t           seed;  /* seed of the mc sequence             */
+   const char*        cumul; /* file for the cumulative integral, or NULL */
+   int                every; /* stride of the cumulative table      */
+   const char*        tab;   /* file of (x, y) samples, or NULL     */
+   const char*        cache; /* cache file, or NULL                 */
+} trap_opts_t;
+
+/*------------------------------------------------------------------
+ * Function:    Trap_opts_usage
+ * Purpose:     Print the options understood by Get_trap_opts
+ */
+static inline void Trap_opts_usage(void) {
+   fprintf(stderr, "options:\n");
+   fprintf(stderr, "   -f <name>   integrand (default %s)\n",
+         DEFAULT_INTEGRAND);
+   fprintf(stderr, "   -expr <expression>  integrand as an expression in x\n");
+   fprintf(stderr, "   -l          list the known integrands\n");
+   fprintf(stderr, "   -isa <isa>  auto, generic, avx2 or avx512\n");
+   fprintf(stderr, "   -adapt <tol>  adaptive Simpson to error tol\n");
+   fprintf(stderr, "   -rule <rule> simpson, boole, gl2, ..., gl5\n");
+   fprintf(stderr, "   -repro      result independent of thread count\n");
+   fprintf(stderr, "   -romberg <levels>  Romberg extrapolation\n");
+   fprintf(stderr, "   -cub <name> 2D/3D cubature of integrand name\n");
+   fprintf(stderr, "   -batch <file> compute the jobs in file\n");
+   fprintf(stderr, "   -qmc <name> (quasi-)Monte Carlo over [a, b]^d\n");
+   fprintf(stderr, "   -seq <seq>  mc, halton or sobol (default)\n");
+   fprintf(stderr, "   -seed <s>   seed for -seq mc\n");
+   fprintf(stderr, "   -cumul <file> write F(x) at the grid points\n");
+   fprintf(stderr, "   -every <k>  with -cumul, every k-th point only\n");
+   fprintf(stderr, "   -cache <file> reuse sums cached in file\n");
+   fprintf(stderr, "   -tab <file> integrate the samples in file\n");
+#ifdef TRAP_OPTS_MPI
+   fprintf(stderr, "   -hybrid     OpenMP threads in each process\n");
+   fprintf(stderr, "   -stream <file> pipeline the jobs in file\n");
+   fprintf(stderr, "   -reduce <s> flat, node, rma or all\n");
+   fprintf(stderr, "   -dynamic <scheme>  rma or master chunk scheduling\n");
+   fprintf(stderr, "   -chunk <k>  trapezoids per chunk with -dynamic\n");
+#endif
+}  /* Trap_opts_usage */
+
+/*------------------------------------------------------------------
+ * Function:    Get_trap_opts
+ * Purpose:     Parse the options in argv[first], ..., argv[argc-1]
+ *              and select the inner loop kernels
+ * Input args:  argc, argv, first
+ *              verbose:  nonzero if errors and listings should be
+ *                        printed (e.g. only on MPI process 0)
+ * Output args: opts_p
+ * Return val:  0 if the program should go on, 1 if it should quit
+ *              normally (-l), -1 if the options are bad
+ */
+static inline int Get_trap_opts(int argc, char* argv[], int first,
+      trap_opts_t* opts_p, int verbose) {
+   int i;
+   trap_isa_t isa = TRAP_ISA_AUTO;
+
+   opts_p->integrand = Find_integrand(DEFAULT_INTEGRAND);
+   opts_p->rule = NULL;
+   opts_p->tol = 0.0;
+   opts_p->repro = 0;
+   opts_p->romberg = 0;
+   opts_p->batch = NULL;
+   opts_p->cub = NULL;
+   opts_p->hybrid = 0;
+   opts_p->stream = NULL;
+   opts_p->reduce = -1;
+   opts_p->dynamic = -1;
+   opts_p->chunk = 0;
+   opts_p->qmc = NULL;
+   opts_p->seq = QMC_SOBOL;
+   opts_p->seed = 1;
+   opts_p->cumul = NULL;
+   opts_p->every = 1;
+   opts_p->tab = NULL;
+   opts_p->cache = NULL;
+
+   for (i = first; i < argc; i++) {
+      if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+         opts_p->integrand = Find_integrand(argv[++i]);
+         if (opts_p->integrand == NULL) {
+            if (verbose) {
+               fprintf(stderr, "Unknown integrand %s\n", argv[i]);
+               List_integrands(stderr);
+            }
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-expr") == 0 && i+1 < argc) {
+         opts_p->integrand = Set_expr_integrand(argv[++i], verbose);
+         if (opts_p->integrand == NULL) return -1;
+      } else if (strcmp(argv[i], "-isa") == 0 && i+1 < argc) {
+         isa = Find_trap_isa(argv[++i]);
+         if (isa == TRAP_ISA_COUNT) {
+            if (verbose)
+               fprintf(stderr, "ISA %s is unknown or not supported\n",
+                     argv[i]);
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-rule") == 0 && i+1 < argc) {
+         opts_p->rule = Find_rule(argv[++i]);
+         if (opts_p->rule == NULL) {
+            if (verbose) {
+               fprintf(stderr, "Unknown rule %s\n", argv[i]);
+               List_rules(stderr);
+            }
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-adapt") == 0 && i+1 < argc) {
+         opts_p->tol = strtod(argv[++i], NULL);
+         if (opts_p->tol <= 0.0) {
+            if (verbose) fprintf(stderr, "tol must be positive\n");
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-repro") == 0) {
+         opts_p->repro = 1;
+      } else if (strcmp(argv[i], "-romberg") == 0 && i+1 < argc) {
+         opts_p->romberg = atoi(argv[++i]);
+         if (opts_p->romberg <= 0) {
+            if (verbose) fprintf(stderr, "levels must be positive\n");
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-cub") == 0 && i+1 < argc) {
+         opts_p->cub = Find_cub_integrand(argv[++i]);
+         if (opts_p->cub == NULL) {
+            if (verbose) {
+               fprintf(stderr, "Unknown integrand %s\n", argv[i]);
+               List_cub_integrands(stderr);
+            }
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-batch") == 0 && i+1 < argc) {
+         opts_p->batch = argv[++i];
+      } else if (strcmp(argv[i], "-qmc") == 0 && i+1 < argc) {
+         opts_p->qmc = Find_qmc_integrand(argv[++i]);
+         if (opts_p->qmc == NULL) {
+            if (verbose) {
+               fprintf(stderr, "Unknown integrand %s\n", argv[i]);
+               List_qmc_integrands(stderr);
+            }
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-seq") == 0 && i+1 < argc) {
+         opts_p->seq = Find_qmc_seq(argv[++i]);
+         if (opts_p->seq == QMC_SEQ_COUNT) {
+            if (verbose) fprintf(stderr, "Unknown sequence %s\n", argv[i]);
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-seed") == 0 && i+1 < argc) {
+         opts_p->seed = strtoull(argv[++i], NULL, 10);
+      } else if (strcmp(argv[i], "-cumul") == 0 && i+1 < argc) {
+         opts_p->cumul = argv[++i];
+      } else if (strcmp(argv[i], "-every") == 0 && i+1 < argc) {
+         opts_p->every = atoi(argv[++i]);
+         if (opts_p->every <= 0) {
+            if (verbose) fprintf(stderr, "k must be positive\n");
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-cache") == 0 && i+1 < argc) {
+         opts_p->cache = argv[++i];
+      } else if (strcmp(argv[i], "-tab") == 0 && i+1 < argc) {
+         opts_p->tab = argv[++i];
+#ifdef TRAP_OPTS_MPI
+      } else if (strcmp(argv[i], "-hybrid") == 0) {
+         opts_p->hybrid = 1;
+      } else if (strcmp(argv[i], "-stream") == 0 && i+1 < argc) {
+         opts_p->stream = argv[++i];
+      } else if (strcmp(argv[i], "-reduce") == 0 && i+1 < argc) {
+         for (opts_p->reduce = 0; opts_p->reduce < REDUCE_COUNT;
+               opts_p->reduce++)
+            if (strcmp(argv[i+1], reduce_names[opts_p->reduce]) == 0)
+               break;
+         i++;
+         if (opts_p->reduce == REDUCE_COUNT) {
+            if (verbose) fprintf(stderr, "Unknown strategy %s\n", argv[i]);
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-dynamic") == 0 && i+1 < argc) {
+         for (opts_p->dynamic = 0; opts_p->dynamic < DYNAMIC_COUNT;
+               opts_p->dynamic++)
+            if (strcmp(argv[i+1], dynamic_names[opts_p->dynamic]) == 0)
+               break;
+         i++;
+         if (opts_p->dynamic == DYNAMIC_COUNT) {
+            if (verbose) fprintf(stderr, "Unknown scheme %s\n", argv[i]);
+            return -1;
+         }
+      } else if (strcmp(argv[i], "-chunk") == 0 && i+1 < argc) {
+         opts_p->chunk = atoi(argv[++i]);
+         if (opts_p->chunk <= 0) {
+            if (verbose) fprintf(stderr, "k must be positive\n");
+            return -1;
+         }
+#endif
+      } else if (strcmp(argv[i], "-l") == 0) {
+         if (verbose) {
+            List_integrands(stdout);
+            List_cub_integrands(stdout);
+            List_qmc_integrands(stdout);
+            List_rules(stdout);
+         }
+         return 1;
+      } else {
+         if (verbose) {
+            fprintf(stderr, "Bad option %s\n", argv[i]);
+            Trap_opts_usage();
+         }
+         return -1;
+      }
+   }
+
+   opts_p->isa = Select_trap_isa(isa);
+   Select_cub_isa(opts_p->isa);
+   Select_qmc_isa(opts_p->isa);
+   Select_expr_isa(opts_p->isa);
+   return 0;
+}  /* Get_trap_opts */
+
+#endif
@@ -0,0 +1,313 @@
+/* File:     vmath.h
+ * Purpose:  exp, log, sin, cos and pow written so that the compiler
+ *           can vectorize loops that call them.
+ *
+ *           The libm functions are opaque calls, so a loop over
+ *           exp(-x*x) runs one abscissa at a time however wide the
+ *           vector unit is.  These versions are static inline and use
+ *           only arithmetic, comparisons, selects and integer
+ *           operations on the bits of doubles (no tables, no branches
+ *           that depend on x), so once inlined into the lane loop of
+ *           DEFINE_TRAP_SUM they become 4-wide (AVX2) or 8-wide
+ *           (AVX-512) code like the rest of the loop.
+ *
+ * Accuracy: Compile with -DVMATH_ULP=<u> to choose the polynomials.
+ *           With the default, 1, the largest errors measured are below
+ *           1 ulp.  u = 4, 64 and 4096 use shorter polynomials with
+ *           errors below u ulp, for integrands that don't need every
+ *           digit (see the table below).  Compile with -DVMATH_LIBM to
+ *           use libm instead, e.g. to compare results.
+ *
+ * Notes:
+ * 1.  Vm_sin and Vm_cos reduce x with a four part pi/2, which is
+ *     accurate for |x| < 2^20*pi/2 (about 1.6e6), even for the x
+ *     nearest a multiple of pi/2.  Beyond that the error grows with
+ *     |x|.
+ * 2.  Vm_pow(x, y) is Vm_exp(y*Vm_log(x)), so the rounding error of
+ *     y*log(x) is magnified: expect up to about 1 + |y*log(x)| ulp.
+ * 3.  exp underflows to 0 and overflows to inf, log(0) = -inf,
+ *     log(x < 0) = NaN, and NaNs propagate, but the sign of zero and
+ *     the floating point exception flags aren't those of libm.
+ * 4.  The 64-bit integer compares don't vectorize with plain SSE2, so
+ *     in the generic kernels of trap_isa.h these functions run one
+ *     lane at a time, and more slowly than libm.  The AVX2 and AVX-512
+ *     kernels are 3 to 10 times faster than libm.
+ */
+#ifndef VMATH_H
+#define VMATH_H
+
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef VMATH_ULP
+#define VMATH_ULP 1
+#endif
+
+/* Degrees of the polynomials for the accuracy asked for.  Largest
+ * errors, in ulp, measured against long double libm for x over the
+ * whole domain, near the ends of the reduced ranges and (sin, cos,
+ * |x| < 1.6e6) at the doubles nearest multiples of pi/2.  The AVX2
+ * and AVX-512 kernels contract to FMAs and round like each other;
+ * the generic kernel doesn't:
+ *
+ *                exp              log              sin, cos
+ *    VMATH_ULP   generic  FMA     generic  FMA     generic  FMA
+ *    1           0.90     0.90    0.99     0.88    0.81     0.79
+ *    4           2.33     2.33    0.99     0.88    1.15     1.10
+ *    64          55.9     55.9    6.37     6.29    1.15     1.10
+ *    4096        1901     1901    212      212     185      185
+ */
+#if VMATH_ULP >= 4096
+#  define VMATH_EXP_DEGREE 10
+#  define VMATH_LOG_TERMS   7
+#  define VMATH_SIN_TERMS   6
+#elif VMATH_ULP >= 64
+#  define VMATH_EXP_DEGREE 11
+#  define VMATH_LOG_TERMS   8
+#  define VMATH_SIN_TERMS   7
+#elif VMATH_ULP >= 4
+#  define VMATH_EXP_DEGREE 12
+#  define VMATH_LOG_TERMS   9
+#  define VMATH_SIN_TERMS   7
+#else
+#  define VMATH_EXP_DEGREE 13
+#  define VMATH_LOG_TERMS   9
+#  define VMATH_SIN_TERMS   8
+#endif
+
+/* The polynomial loops must be unrolled before the vectorizer sees
+ * the caller's loop, which gcc -O2 doesn't do on its own */
+#if defined(__clang__)
+#  define VMATH_UNROLL _Pragma("clang loop unroll(full)")
+#elif defined(__GNUC__) && __GNUC__ >= 8
+#  define VMATH_UNROLL _Pragma("GCC unroll 16")
+#else
+#  define VMATH_UNROLL
+#endif
+
+#ifdef VMATH_LIBM
+
+#define Vm_exp exp
+#define Vm_log log
+#define Vm_sin sin
+#define Vm_cos cos
+#define Vm_pow pow
+
+#else
+
+#define VMATH_ROUND   6755399441055744.0   /* 1.5*2^52 */
+#define VMATH_LN2_HI  6.93147180369123816490e-01
+#define VMATH_LN2_LO  1.90821492927058770002e-10
+#define VMATH_PIO2_1  1.57079632673412561417e+00   /* first 33 bits  */
+#define VMATH_PIO2_2  6.07710050630396597660e-11   /* next 33 bits   */
+#define VMATH_PIO2_3  2.02226624871116645580e-21   /* next 33 bits   */
+#define VMATH_PIO2_4  8.47842766036889956997e-32   /* the rest       */
+
+/* Reinterpret the bits of a double as an integer and back */
+static inline uint64_t Vm_bits(double x) {
+   uint64_t u;
+   memcpy(&u, &x, sizeof(u));
+   return u;
+}
+
+static inline double Vm_double(uint64_t u) {
+   double x;
+   memcpy(&x, &u, sizeof(x));
+   return x;
+}
+
+/* cond ? a : b, with bit masks.  gcc turns ?: on doubles into
+ * branches around whatever computes a or b, and those branches keep
+ * the caller's loop from vectorizing without AVX-512 masking. */
+static inline double Vm_select(int cond, double a, double b) {
+   uint64_t mask = (uint64_t) 0 - (uint64_t) (cond != 0);
+   return Vm_double((Vm_bits(a) & mask) | (Vm_bits(b) & ~mask));
+}
+
+/*------------------------------------------------------------------
+ * Function:    Vm_exp
+ * Purpose:     e^x.  Writes x = n*ln2 + r with |r| <= ln2/2, and
+ *              multiplies the Taylor polynomial of e^r by 2^n, as two
+ *              factors so that subnormal results are right too.  The
+ *              polynomial is summed as 1 + (hi + (r^2*q - lo)), with
+ *              r = hi - lo, so that only the last two additions round
+ *              at the size of r or of the result.
+ */
+static inline double Vm_exp(double x) {
+   static const double c[14] = {1.0, 1.0, 1.0/2, 1.0/6, 1.0/24,
+      1.0/120, 1.0/720, 1.0/5040, 1.0/40320, 1.0/362880,
+      1.0/3628800, 1.0/39916800, 1.0/479001600, 1.0/6227020800.0};
+   double t, n, hi, lo, r, p, y;
+   uint64_t nb, n1b;
+   int i;
+
+   /* The low bits of t hold n = round(x/ln2) */
+   t = x*1.44269504088896338700 + VMATH_ROUND;
+   n = t - VMATH_ROUND;
+   hi = x - n*VMATH_LN2_HI;   /* exact */
+   lo = n*VMATH_LN2_LO;
+   r = hi - lo;
+
+   p = c[VMATH_EXP_DEGREE];
+   VMATH_UNROLL
+   for (i = VMATH_EXP_DEGREE - 1; i >= 2; i--)
+      p = p*r + c[i];
+   p = 1.0 + (hi + (r*r*p - lo));
+
+   /* 2^n = 2^n1 * 2^(n-n1) with n1 = floor(n/2), biased by 2048 */
+   nb = Vm_bits(t) - Vm_bits(VMATH_ROUND) + 2048;
+   n1b = nb >> 1;
+   y = p*Vm_double((n1b - 1) << 52)*Vm_double((nb - n1b - 1) << 52);
+
+   y = Vm_select(x > 709.8, HUGE_VAL, y);
+   return Vm_select(x < -745.2, 0.0, y);
+}  /* Vm_exp */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_log
+ * Purpose:     Natural log.  Writes x = 2^k*m with sqrt(1/2) <= m <
+ *              sqrt(2), and log(m) = 2*atanh(s), s = (m-1)/(m+1), by
+ *              its Taylor series in s.  As in fdlibm, the series is
+ *              rearranged so that f = m - 1, which is exact, is added
+ *              last.
+ */
+static inline double Vm_log(double x) {
+   int subnormal = x < 2.2250738585072014e-308;
+   double y, m, f, hfsq, s, z, p, k;
+   uint64_t ix, kb;
+   int i;
+
+   /* Scale subnormals up by 2^54 */
+   ix = Vm_bits(x*Vm_select(subnormal, 18014398509481984.0, 1.0));
+   /* kb = k + 1023 + (54 if subnormal) */
+   kb = (ix + 0x00095F619980C433ULL) >> 52;
+   m = Vm_double(ix - (kb << 52) + (1023ULL << 52));
+   k = Vm_double(kb | 0x4330000000000000ULL) - 4503599627370496.0
+      - Vm_select(subnormal, 1077.0, 1023.0);
+
+   /* log(m) = 2s + s*R with R = 2z/3 + 2z^2/5 + ..., and 2s = f - s*f
+    * = f - hfsq + s*hfsq, so log(m) = f - (hfsq - s*(hfsq + R)) */
+   f = m - 1.0;
+   hfsq = 0.5*f*f;
+   s = f/(2.0 + f);
+   z = s*s;
+   p = 2.0/(2*VMATH_LOG_TERMS + 1);
+   VMATH_UNROLL
+   for (i = VMATH_LOG_TERMS - 1; i > 0; i--)
+      p = p*z + 2.0/(2*i + 1);
+   y = k*VMATH_LN2_HI
+      - ((hfsq - (s*(hfsq + z*p) + k*VMATH_LN2_LO)) - f);
+
+   y = Vm_select(x == 0.0, -HUGE_VAL, y);
+   y = Vm_select(x < 0.0, NAN, y);
+   return Vm_select((x > 1.7976931348623157e308) | (x != x), x, y);
+}  /* Vm_log */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_sincos_reduced
+ * Purpose:     Polynomials for sin(r + rr) and cos(r + rr), |r| <= pi/4
+ *              and rr below an ulp of r.  As in fdlibm, r (for sin)
+ *              and 1 - r^2/2 (for cos) are added last.
+ */
+static inline void Vm_sincos_reduced(double r, double rr, double* sin_p,
+      double* cos_p) {
+   static const double s[9] = {1.0, -1.0/6, 1.0/120, -1.0/5040,
+      1.0/362880, -1.0/39916800, 1.0/6227020800.0,
+      -1.0/1307674368000.0, 1.0/355687428096000.0};
+   static const double c[10] = {1.0, -1.0/2, 1.0/24, -1.0/720,
+      1.0/40320, -1.0/3628800, 1.0/479001600, -1.0/87178291200.0,
+      1.0/20922789888000.0, -1.0/6402373705728000.0};
+   double z = r*r, hz = 0.5*z, w = 1.0 - hz, ps, pc;
+   int i;
+
+   ps = s[VMATH_SIN_TERMS];
+   pc = c[VMATH_SIN_TERMS + 1];
+   VMATH_UNROLL
+   for (i = VMATH_SIN_TERMS - 1; i >= 1; i--)
+      ps = ps*z + s[i];
+   VMATH_UNROLL
+   for (i = VMATH_SIN_TERMS; i >= 2; i--)
+      pc = pc*z + c[i];
+   /* sin(r + rr) = sin(r) + rr*cos(r), cos(r + rr) = cos(r) - rr*sin(r) */
+   *sin_p = r + (r*z*ps + rr*w);
+   *cos_p = w + (((1.0 - w) - hz) + (z*z*pc - r*rr));
+}  /* Vm_sincos_reduced */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_sincos_quadrant
+ * Purpose:     Write x = q*pi/2 + r + rr with |r| <= pi/4 and rr the
+ *              rounding error of r, and return r, rr and the low bits
+ *              of q.  For |q| < 2^20 the products of q with the first
+ *              three parts of pi/2 are exact, so only q*VMATH_PIO2_4
+ *              rounds, and the subtractions are exact or keep their
+ *              rounding errors in rr.
+ */
+static inline double Vm_sincos_quadrant(double x, double* rr_p,
+      uint64_t* q_p) {
+   double t = x*6.36619772367581382433e-01 + VMATH_ROUND;
+   double q = t - VMATH_ROUND;
+   double y = x - q*VMATH_PIO2_1, w = q*VMATH_PIO2_2, r = y - w;
+   double rr = (y - r) - w, hi;
+
+   y = r;
+   w = q*VMATH_PIO2_3;
+   r = y - w;
+   rr += ((y - r) - w) - q*VMATH_PIO2_4;
+   hi = r + rr;
+   *rr_p = rr - (hi - r);
+   *q_p = Vm_bits(t);
+   return hi;
+}  /* Vm_sincos_quadrant */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_sin
+ */
+static inline double Vm_sin(double x) {
+   uint64_t q;
+   double rr, r = Vm_sincos_quadrant(x, &rr, &q), s, c, y;
+
+   Vm_sincos_reduced(r, rr, &s, &c);
+   y = Vm_select((int) (q & 1), c, s);
+   return Vm_double(Vm_bits(y) ^ ((q & 2) << 62));
+}  /* Vm_sin */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_cos
+ */
+static inline double Vm_cos(double x) {
+   uint64_t q;
+   double rr, r = Vm_sincos_quadrant(x, &rr, &q), s, c, y;
+
+   Vm_sincos_reduced(r, rr, &s, &c);
+   y = Vm_select((int) (q & 1), s, c);
+   return Vm_double(Vm_bits(y) ^ (((q + 1) & 2) << 62));
+}  /* Vm_cos */
+
+/*------------------------------------------------------------------
+ * Function:    Vm_pow
+ * Purpose:     x^y, as exp(y*log|x|), negated for x < 0 and odd
+ *              integer y, and NaN for x < 0 and y not an integer
+ */
+static inline double Vm_pow(double x, double y) {
+   double ay = fabs(y);
+   /* t = 2^52 + |y|, which the addition rounds to an integer, or |y|
+    * itself if |y| >= 2^52, when it already is one.  Below 2^53 the
+    * ulp of t is 1, so its last bit is the parity of the integer; from
+    * 2^53 on every double is even. */
+   double t = Vm_select(ay < 4503599627370496.0, ay + 4503599627370496.0,
+         ay);
+   double rounded = Vm_select(ay < 4503599627370496.0,
+         t - 4503599627370496.0, ay);
+   uint64_t odd = Vm_bits(t) & (uint64_t) (ay < 9007199254740992.0);
+   double z = Vm_exp(y*Vm_log(fabs(x)));
+
+   /* Odd integer y: the sign of x */
+   z = Vm_double(Vm_bits(z) ^ ((odd & Vm_bits(x) >> 63) << 63));
+   z = Vm_select(rounded != ay, Vm_select(x < 0.0, NAN, z), z);
+   return Vm_select(y == 0.0, 1.0, z);
+}  /* Vm_pow */
+
+#endif   /* VMATH_LIBM */
+
+#endif
@@ -9,11 +9,34 @@
  *
  * Compile:  mpicc -g -Wall -o mpi_odd_even mpi_odd_even.c
  * Run:
- *    mpiexec -n <p> mpi_odd_even <g|i> <global_n> 
+ *    mpiexec -n <p> mpi_odd_even <g|i> <global_n> [o|s]
  *       - p: the number of processes
  *       - g: generate random, distributed list
  *       - i: user will input list on process 0
  *       - global_n: number of elements in global list
+ *       - o: odd-even transposition sort (the default)
+ *       - s: sample sort
+ *
+ * Odd-even sort:
+ *    In each of p phases a process merge-splits its sorted keys with a
+ *    neighbour's.  The partners first swap their boundary keys and
+ *    skip the phase if the blocks are already in order; otherwise
+ *    each sends only the keys that can change sides (see
+ *    Merge_split), so late phases and nearly sorted lists move few
+ *    keys.  The keys go in chunks of MERGE_CHUNK, each
+ *    posted with MPI_Isend/MPI_Irecv, in the order the partner's merge
+ *    uses them, and the merge only waits for a chunk when it gets to
+ *    it, so most of the transfer overlaps the merging.
+ *
+ * Sample sort:
+ *    Each process sorts its list and sends SAMPLE_OVERSAMPLE evenly
+ *    spaced keys to all the others (MPI_Allgather).  Every process
+ *    sorts the p*SAMPLE_OVERSAMPLE samples and takes the same p-1
+ *    splitters from them, which cut the keys into p ranges of about
+ *    global_n/p keys.  One MPI_Alltoallv sends each process the keys
+ *    in its range, as p sorted runs, which it merges.  Every key
+ *    crosses the network at most once, however many processes there
+ *    are; afterwards the processes hold different numbers of keys.
  *
  * Notes:
  * 1.  global_n must be evenly divisible by p
@@ -24,27 +47,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <mpi.h>
+#include "../Common/sample_sort.h"
 
 const int RMAX = 100;
 
+/* Keys in each message of a merge-split exchange */
+#define MERGE_CHUNK 16384
+
 /* Local functions */
 void Usage(char* program);
 void Print_list(int local_A[], int local_n, int rank);
-void Merge_low(int local_A[], int temp_B[], int temp_C[], 
-         int local_n);
-void Merge_high(int local_A[], int temp_B[], int temp_C[], 
-        int local_n);
+int  Count_less(int keys[], int n, int key);
+int  Count_less_equal(int keys[], int n, int key);
+void Chunk_range(int n, int c, int from_top, int* first_p, int* count_p);
 void Generate_list(int local_A[], int local_n, int my_rank);
 int  Compare(const void* a_p, const void* b_p);
+void Merge(int A[], int A_n, int B[], int B_n, int C[]);
+void Merge_runs(int runs[], int counts[], int displs[], int p,
+         int temp[]);
 
 /* Functions involving communication */
 void Get_args(int argc, char* argv[], int* global_n_p, int* local_n_p, 
-         char* gi_p, int my_rank, int p, MPI_Comm comm);
+         char* gi_p, char* sort_p, int my_rank, int p, MPI_Comm comm);
 void Sort(int local_A[], int local_n, int my_rank, 
          int p, MPI_Comm comm);
+int* Sample_sort(int local_A[], int local_n, int* new_n_p, int my_rank,
+         int p, MPI_Comm comm);
 void Odd_even_iter(int local_A[], int temp_B[], int temp_C[],
          int local_n, int phase, int even_partner, int odd_partner,
          int my_rank, int p, MPI_Comm comm);
+void Merge_split(int local_A[], int temp_B[], int temp_C[],
+         int local_n, int partner, int keep_low, MPI_Comm comm);
+void Merge_low(int local_A[], int temp_B[], int temp_C[], 
+         int local_n, int recv_n, MPI_Request chunk_reqs[]);
+void Merge_high(int local_A[], int temp_B[], int temp_C[], 
+        int local_n, int recv_n, MPI_Request chunk_reqs[]);
 void Print_local_lists(int local_A[], int local_n, 
          int my_rank, int p, MPI_Comm comm);
 void Print_global_list(int local_A[], int local_n, int my_rank,
@@ -57,7 +94,9 @@ void Read_list(int local_A[], int local_n, int my_rank, int p,
 int main(int argc, char* argv[]) {
    int my_rank, p;
    char g_i;
-   int *local_A;
+   char sort;
+   int *local_A, *sorted_A;
+   int sorted_n;
    int global_n;
    int local_n;
    MPI_Comm comm;
@@ -69,7 +108,7 @@ int main(int argc, char* argv[]) {
    MPI_Comm_size(comm, &p);
    MPI_Comm_rank(comm, &my_rank);
 
-   Get_args(argc, argv, &global_n, &local_n, &g_i, my_rank, p, comm);
+   Get_args(argc, argv, &global_n, &local_n, &g_i, &sort, my_rank, p, comm);
    local_A = (int*) malloc(local_n*sizeof(int));
 
    if (g_i == 'g') {
@@ -88,7 +127,14 @@ int main(int argc, char* argv[]) {
 #  endif
 
    local_beg = MPI_Wtime();
-   Sort(local_A, local_n, my_rank, p, comm);
+   if (sort == 's') {
+      sorted_A = Sample_sort(local_A, local_n, &sorted_n, my_rank, p, comm);
+      free(local_A);
+      local_A = sorted_A;
+      local_n = sorted_n;
+   } else {
+      Sort(local_A, local_n, my_rank, p, comm);
+   }
    local_end = MPI_Wtime();
 
 #  ifdef DEBUG
@@ -135,13 +181,15 @@ void Generate_list(int local_A[], int local_n, int my_rank) {
  * Note:      Purely local, run only by process 0;
  */
 void Usage(char* program) {
-   fprintf(stderr, "usage:  mpirun -np <p> %s <g|i> <global_n>\n",
+   fprintf(stderr, "usage:  mpirun -np <p> %s <g|i> <global_n> [o|s]\n",
        program);
    fprintf(stderr, "   - p: the number of processes \n");
    fprintf(stderr, "   - g: generate random, distributed list\n");
    fprintf(stderr, "   - i: user will input list on process 0\n");
    fprintf(stderr, "   - global_n: number of elements in global list");
    fprintf(stderr, " (must be evenly divisible by p)\n");
+   fprintf(stderr, "   - o: odd-even transposition sort (default)\n");
+   fprintf(stderr, "   - s: sample sort\n");
    fflush(stderr);
 }  /* Usage */
 
@@ -150,18 +198,20 @@ void Usage(char* program) {
  * Function:    Get_args
  * Purpose:     Get and check command line arguments
  * Input args:  argc, argv, my_rank, p, comm
- * Output args: global_n_p, local_n_p, gi_p
+ * Output args: global_n_p, local_n_p, gi_p, sort_p
  */
 void Get_args(int argc, char* argv[], int* global_n_p, int* local_n_p, 
-         char* gi_p, int my_rank, int p, MPI_Comm comm) {
+         char* gi_p, char* sort_p, int my_rank, int p, MPI_Comm comm) {
 
    if (my_rank == 0) {
-      if (argc != 3) {
+      if (argc != 3 && argc != 4) {
          Usage(argv[0]);
          *global_n_p = -1;  /* Bad args, quit */
       } else {
          *gi_p = argv[1][0];
-         if (*gi_p != 'g' && *gi_p != 'i') {
+         *sort_p = argc == 4 ? argv[3][0] : 'o';
+         if ((*gi_p != 'g' && *gi_p != 'i')
+               || (*sort_p != 'o' && *sort_p != 's')) {
             Usage(argv[0]);
             *global_n_p = -1;  /* Bad args, quit */
          } else {
@@ -175,6 +225,7 @@ void Get_args(int argc, char* argv[], int* global_n_p, int* local_n_p,
    }  /* my_rank == 0 */
 
    MPI_Bcast(gi_p, 1, MPI_CHAR, 0, comm);
+   MPI_Bcast(sort_p, 1, MPI_CHAR, 0, comm);
    MPI_Bcast(global_n_p, 1, MPI_INT, 0, comm);
 
    if (*global_n_p <= 0) {
@@ -225,26 +276,40 @@ void Read_list(int local_A[], int local_n, int my_rank, int p,
  * Input args:  
  *    n, the number of elements 
  *    A, the list
- * Note:       Purely local, called only by process 0
+ * Note:       The processes needn't all have the same local_n
  */
 void Print_global_list(int local_A[], int local_n, int my_rank, int p, 
       MPI_Comm comm) {
    int* A = NULL;
-   int i, n;
+   int* counts = NULL;
+   int* displs = NULL;
+   int i, q, n;
 
    if (my_rank == 0) {
-      n = p*local_n;
+      counts = (int*) malloc(p*sizeof(int));
+      displs = (int*) malloc(p*sizeof(int));
+   }
+   MPI_Gather(&local_n, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+
+   if (my_rank == 0) {
+      n = 0;
+      for (q = 0; q < p; q++) {
+         displs[q] = n;
+         n += counts[q];
+      }
       A = (int*) malloc(n*sizeof(int));
-      MPI_Gather(local_A, local_n, MPI_INT, A, local_n, MPI_INT, 0,
-            comm);
+      MPI_Gatherv(local_A, local_n, MPI_INT, A, counts, displs, MPI_INT,
+            0, comm);
       printf("Global list:\n");
       for (i = 0; i < n; i++)
          printf("%d ", A[i]);
       printf("\n\n");
       free(A);
+      free(counts);
+      free(displs);
    } else {
-      MPI_Gather(local_A, local_n, MPI_INT, A, local_n, MPI_INT, 0,
-            comm);
+      MPI_Gatherv(local_A, local_n, MPI_INT, A, counts, displs, MPI_INT,
+            0, comm);
    }
 
 }  /* Print_global_list */
@@ -313,6 +378,113 @@ void Sort(int local_A[], int local_n, int my_rank,
 }  /* Sort */
 
 
+/*-------------------------------------------------------------------
+ * Function:    Sample_sort
+ * Purpose:     Sort the global list by sample sort
+ * Input args:  local_A, local_n, my_rank, p, comm
+ * Output arg:  new_n_p:  the number of keys this process ends with
+ * Return val:  This process' keys, the new_n smallest after those of
+ *              the processes before it, sorted, in a new list
+ * Note:        local_A is sorted in place
+ */
+int* Sample_sort(int local_A[], int local_n, int* new_n_p, int my_rank,
+         int p, MPI_Comm comm) {
+   int *samples, *splitters;
+   int *send_counts, *send_displs, *recv_counts, *recv_displs;
+   int *new_A, *temp;
+   int q, new_n;
+
+   samples = (int*) malloc(p*SAMPLE_OVERSAMPLE*sizeof(int));
+   splitters = (int*) malloc(p*sizeof(int));
+   send_counts = (int*) malloc(p*sizeof(int));
+   send_displs = (int*) malloc(p*sizeof(int));
+   recv_counts = (int*) malloc(p*sizeof(int));
+   recv_displs = (int*) malloc(p*sizeof(int));
+
+   qsort(local_A, local_n, sizeof(int), Compare);
+
+   /* Every process chooses the same splitters */
+   Sample_pick(local_A, local_n, samples + my_rank*SAMPLE_OVERSAMPLE);
+   MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, samples,
+         SAMPLE_OVERSAMPLE, MPI_INT, comm);
+   qsort(samples, p*SAMPLE_OVERSAMPLE, sizeof(int), Compare);
+   Sample_splitters(samples, p, splitters);
+
+   /* local_A is sorted, so the keys for process q are contiguous */
+   Sample_count(local_A, local_n, splitters, p, send_counts);
+   MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+   send_displs[0] = recv_displs[0] = 0;
+   for (q = 1; q < p; q++) {
+      send_displs[q] = send_displs[q-1] + send_counts[q-1];
+      recv_displs[q] = recv_displs[q-1] + recv_counts[q-1];
+   }
+   new_n = recv_displs[p-1] + recv_counts[p-1];
+
+   new_A = (int*) malloc((new_n > 0 ? new_n : 1)*sizeof(int));
+   temp = (int*) malloc((new_n > 0 ? new_n : 1)*sizeof(int));
+   MPI_Alltoallv(local_A, send_counts, send_displs, MPI_INT,
+         new_A, recv_counts, recv_displs, MPI_INT, comm);
+   Merge_runs(new_A, recv_counts, recv_displs, p, temp);
+
+   free(samples);
+   free(splitters);
+   free(send_counts);
+   free(send_displs);
+   free(recv_counts);
+   free(recv_displs);
+   free(temp);
+
+   *new_n_p = new_n;
+   return new_A;
+}  /* Sample_sort */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge_runs
+ * Purpose:     Merge the p sorted runs runs[displs[q]], ...,
+ *              runs[displs[q]+counts[q]-1], which lie one after the
+ *              other, into one sorted list.  Neighbouring runs are
+ *              merged in pairs, halving the number of runs each round.
+ * In/out args: runs, counts, displs
+ * Scratch:     temp
+ */
+void Merge_runs(int runs[], int counts[], int displs[], int p,
+         int temp[]) {
+   int step, q;
+
+   for (step = 1; step < p; step *= 2) {
+      for (q = 0; q + step < p; q += 2*step) {
+         Merge(runs + displs[q], counts[q], runs + displs[q+step],
+               counts[q+step], temp);
+         counts[q] += counts[q+step];
+         memcpy(runs + displs[q], temp, counts[q]*sizeof(int));
+      }
+   }
+}  /* Merge_runs */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Merge
+ * Purpose:     Merge the sorted lists A and B into C
+ * In args:     A, A_n, B, B_n
+ * Out arg:     C
+ */
+void Merge(int A[], int A_n, int B[], int B_n, int C[]) {
+   int ai = 0, bi = 0, ci = 0;
+
+   while (ai < A_n && bi < B_n) {
+      if (A[ai] <= B[bi])
+         C[ci++] = A[ai++];
+      else
+         C[ci++] = B[bi++];
+   }
+   while (ai < A_n)
+      C[ci++] = A[ai++];
+   while (bi < B_n)
+      C[ci++] = B[bi++];
+}  /* Merge */
+
+
 /*-------------------------------------------------------------------
  * Function:    Odd_even_iter
  * Purpose:     One iteration of Odd-even transposition sort
@@ -323,51 +495,218 @@ void Sort(int local_A[], int local_n, int my_rank,
 void Odd_even_iter(int local_A[], int temp_B[], int temp_C[],
         int local_n, int phase, int even_partner, int odd_partner,
         int my_rank, int p, MPI_Comm comm) {
-   MPI_Status status;
 
    if (phase % 2 == 0) {
       if (even_partner >= 0) {
-         MPI_Sendrecv(local_A, local_n, MPI_INT, even_partner, 0, 
-            temp_B, local_n, MPI_INT, even_partner, 0, comm,
-            &status);
          if (my_rank % 2 != 0)
-            Merge_high(local_A, temp_B, temp_C, local_n);
+            Merge_split(local_A, temp_B, temp_C, local_n, even_partner,
+                  0, comm);
          else
-            Merge_low(local_A, temp_B, temp_C, local_n);
+            Merge_split(local_A, temp_B, temp_C, local_n, even_partner,
+                  1, comm);
       }
    } else { /* odd phase */
       if (odd_partner >= 0) {
-         MPI_Sendrecv(local_A, local_n, MPI_INT, odd_partner, 0, 
-            temp_B, local_n, MPI_INT, odd_partner, 0, comm,
-            &status);
          if (my_rank % 2 != 0)
-            Merge_low(local_A, temp_B, temp_C, local_n);
+            Merge_split(local_A, temp_B, temp_C, local_n, odd_partner,
+                  1, comm);
          else
-            Merge_high(local_A, temp_B, temp_C, local_n);
+            Merge_split(local_A, temp_B, temp_C, local_n, odd_partner,
+                  0, comm);
       }
    }
 }  /* Odd_even_iter */
 
 
+/*-------------------------------------------------------------------
+ * Function:    Merge_split
+ * Purpose:     Merge-split local_A with the partner's keys, keeping
+ *              the smallest local_n keys if keep_low, and the largest
+ *              if not.  Only the keys that can change sides are sent.
+ * In args:     local_n, partner, keep_low, comm
+ * In/out args: local_A
+ * Scratch:     temp_B, temp_C
+ * Notes:
+ * 1.  The partners first swap their boundary keys, the lower process
+ *     its largest and the higher its smallest.  If those are in order
+ *     the blocks are too, and the phase is skipped.
+ * 2.  Otherwise a key of the lower process can only move up if it is
+ *     greater than the partner's smallest key, and a key of the higher
+ *     process can only move down if it is less than the partner's
+ *     largest.  Each process finds that suffix or prefix of its sorted
+ *     keys by binary search and sends just that.  Only that part of
+ *     local_A is merged; the rest stays where it is.
+ * 3.  The keys are sent in chunks of MERGE_CHUNK (see Chunk_range),
+ *     the lower process' largest first and the higher process'
+ *     smallest first, which is the order the partner's Merge_high or
+ *     Merge_low uses them.  The merge waits for each chunk as it
+ *     reaches it, while the later ones are still in flight.
+ */
+void Merge_split(int local_A[], int temp_B[], int temp_C[],
+        int local_n, int partner, int keep_low, MPI_Comm comm) {
+   int my_bound, partner_bound;
+   int send_n, recv_n;
+   int* send_keys;
+   int *head_out, *head_in;
+   int max_chunks, send_chunks, recv_chunks, c, first, count;
+   MPI_Request head_req;
+   MPI_Request *send_reqs, *recv_reqs;
+   MPI_Status status;
+
+   my_bound = keep_low ? local_A[local_n-1] : local_A[0];
+   MPI_Sendrecv(&my_bound, 1, MPI_INT, partner, 0,
+         &partner_bound, 1, MPI_INT, partner, 0, comm, &status);
+   if (keep_low ? my_bound <= partner_bound : partner_bound <= my_bound)
+      return;  /* Already in order */
+
+   if (keep_low) {
+      send_n = local_n - Count_less_equal(local_A, local_n, partner_bound);
+      send_keys = local_A + local_n - send_n;
+   } else {
+      send_n = Count_less(local_A, local_n, partner_bound);
+      send_keys = local_A;
+   }
+
+   /* The first chunk carries the number of keys sent */
+   head_out = (int*) malloc((MERGE_CHUNK+1)*sizeof(int));
+   head_in = (int*) malloc((MERGE_CHUNK+1)*sizeof(int));
+   max_chunks = (local_n + MERGE_CHUNK - 1)/MERGE_CHUNK;
+   send_reqs = (MPI_Request*) malloc(max_chunks*sizeof(MPI_Request));
+   recv_reqs = (MPI_Request*) malloc(max_chunks*sizeof(MPI_Request));
+
+   MPI_Irecv(head_in, MERGE_CHUNK+1, MPI_INT, partner, 0, comm, &head_req);
+   send_chunks = (send_n + MERGE_CHUNK - 1)/MERGE_CHUNK;
+   Chunk_range(send_n, 0, keep_low, &first, &count);
+   head_out[0] = send_n;
+   memcpy(head_out + 1, send_keys + first, count*sizeof(int));
+   MPI_Isend(head_out, count+1, MPI_INT, partner, 0, comm, &send_reqs[0]);
+   for (c = 1; c < send_chunks; c++) {
+      Chunk_range(send_n, c, keep_low, &first, &count);
+      MPI_Isend(send_keys + first, count, MPI_INT, partner, 0, comm,
+            &send_reqs[c]);
+   }
+
+   MPI_Wait(&head_req, &status);
+   recv_n = head_in[0];
+   recv_chunks = (recv_n + MERGE_CHUNK - 1)/MERGE_CHUNK;
+   Chunk_range(recv_n, 0, !keep_low, &first, &count);
+   memcpy(temp_B + first, head_in + 1, count*sizeof(int));
+   recv_reqs[0] = MPI_REQUEST_NULL;
+   for (c = 1; c < recv_chunks; c++) {
+      Chunk_range(recv_n, c, !keep_low, &first, &count);
+      MPI_Irecv(temp_B + first, count, MPI_INT, partner, 0, comm,
+            &recv_reqs[c]);
+   }
+
+   if (keep_low)
+      Merge_low(send_keys, temp_B, temp_C, send_n, recv_n, recv_reqs);
+   else
+      Merge_high(send_keys, temp_B, temp_C, send_n, recv_n, recv_reqs);
+
+   /* The merge may not need every chunk, and send_keys can't be
+    * overwritten until the sends are done */
+   MPI_Waitall(recv_chunks, recv_reqs, MPI_STATUSES_IGNORE);
+   MPI_Waitall(send_chunks > 0 ? send_chunks : 1, send_reqs,
+         MPI_STATUSES_IGNORE);
+   memcpy(send_keys, temp_C, send_n*sizeof(int));
+
+   free(head_out);
+   free(head_in);
+   free(send_reqs);
+   free(recv_reqs);
+}  /* Merge_split */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Count_less
+ * Purpose:     Number of keys in the sorted list keys that are less
+ *              than key
+ */
+int Count_less(int keys[], int n, int key) {
+   int lo = 0, hi = n, mid;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo)/2;
+      if (keys[mid] < key)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}  /* Count_less */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Count_less_equal
+ * Purpose:     Number of keys in the sorted list keys that are less
+ *              than or equal to key
+ */
+int Count_less_equal(int keys[], int n, int key) {
+   int lo = 0, hi = n, mid;
+
+   while (lo < hi) {
+      mid = lo + (hi - lo)/2;
+      if (keys[mid] <= key)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+   return lo;
+}  /* Count_less_equal */
+
+
+/*-------------------------------------------------------------------
+ * Function:    Chunk_range
+ * Purpose:     Find chunk c of a list of n keys sent MERGE_CHUNK keys
+ *              at a time, from the end of the list if from_top and
+ *              from the start if not
+ * Output args: first_p, count_p:  the chunk is keys first, ...,
+ *              first+count-1
+ */
+void Chunk_range(int n, int c, int from_top, int* first_p, int* count_p) {
+   int lo, hi;
+
+   if (from_top) {
+      hi = n - c*MERGE_CHUNK;
+      lo = hi - MERGE_CHUNK > 0 ? hi - MERGE_CHUNK : 0;
+   } else {
+      lo = c*MERGE_CHUNK;
+      hi = lo + MERGE_CHUNK < n ? lo + MERGE_CHUNK : n;
+   }
+   *first_p = lo;
+   *count_p = hi > lo ? hi - lo : 0;
+}  /* Chunk_range */
+
+
 /*-------------------------------------------------------------------
  * Function:    Merge_low
  * Purpose:     Merge the smallest local_n elements in my_keys
- *              and recv_keys into temp_keys.  Then copy temp_keys
- *              back into my_keys.
- * In args:     local_n, recv_keys
- * In/out args: my_keys
- * Scratch:     temp_keys
+ *              and recv_keys into temp_keys.
+ * In args:     my_keys, local_n, recv_keys, recv_n
+ * Out args:    temp_keys
+ * In/out args: chunk_reqs:  chunk c > 0 of recv_keys (as in
+ *              Chunk_range, from the start) has arrived once
+ *              chunk_reqs[c] completes; chunk 0 is already there
  */
 void Merge_low(
-      int  my_keys[],     /* in/out    */
+      int  my_keys[],     /* in        */
       int  recv_keys[],   /* in        */
-      int  temp_keys[],   /* scratch   */
-      int  local_n        /* = n/p, in */) {
+      int  temp_keys[],   /* out       */
+      int  local_n,       /* in        */
+      int  recv_n,        /* in        */
+      MPI_Request chunk_reqs[] /* in/out */) {
    int m_i, r_i, t_i;
+   int avail, next;
    
    m_i = r_i = t_i = 0;
+   avail = MERGE_CHUNK < recv_n ? MERGE_CHUNK : recv_n;
+   next = 1;
    while (t_i < local_n) {
-      if (my_keys[m_i] <= recv_keys[r_i]) {
+      if (r_i == avail && r_i < recv_n) {
+         MPI_Wait(&chunk_reqs[next++], MPI_STATUS_IGNORE);
+         avail = avail + MERGE_CHUNK < recv_n ? avail + MERGE_CHUNK : recv_n;
+      }
+      if (r_i >= recv_n || my_keys[m_i] <= recv_keys[r_i]) {
          temp_keys[t_i] = my_keys[m_i];
          t_i++; m_i++;
       } else {
@@ -375,28 +714,34 @@ void Merge_low(
          t_i++; r_i++;
       }
    }
-
-   memcpy(my_keys, temp_keys, local_n*sizeof(int));
 }  /* Merge_low */
 
 /*-------------------------------------------------------------------
  * Function:    Merge_high
  * Purpose:     Merge the largest local_n elements in local_A 
- *              and temp_B into temp_C.  Then copy temp_C
- *              back into local_A.
- * In args:     local_n, temp_B
- * In/out args: local_A
- * Scratch:     temp_C
+ *              and temp_B into temp_C.
+ * In args:     local_A, local_n, temp_B, recv_n
+ * Out args:    temp_C
+ * In/out args: chunk_reqs:  chunk c > 0 of temp_B (as in Chunk_range,
+ *              from the end) has arrived once chunk_reqs[c]
+ *              completes; chunk 0 is already there
  */
 void Merge_high(int local_A[], int temp_B[], int temp_C[], 
-        int local_n) {
+        int local_n, int recv_n, MPI_Request chunk_reqs[]) {
    int ai, bi, ci;
+   int avail, next;
    
    ai = local_n-1;
-   bi = local_n-1;
+   bi = recv_n-1;
    ci = local_n-1;
+   avail = recv_n - MERGE_CHUNK > 0 ? recv_n - MERGE_CHUNK : 0;
+   next = 1;
    while (ci >= 0) {
-      if (local_A[ai] >= temp_B[bi]) {
+      if (bi == avail - 1 && bi >= 0) {
+         MPI_Wait(&chunk_reqs[next++], MPI_STATUS_IGNORE);
+         avail = avail - MERGE_CHUNK > 0 ? avail - MERGE_CHUNK : 0;
+      }
+      if (bi < 0 || local_A[ai] >= temp_B[bi]) {
          temp_C[ci] = local_A[ai];
          ci--; ai--;
       } else {
@@ -404,8 +749,6 @@ void Merge_high(int local_A[], int temp_B[], int temp_C[],
          ci--; bi--;
       }
    }
-
-   memcpy(local_A, temp_C, local_n*sizeof(int));
 }  /* Merge_high */
 
 
@@ -425,23 +768,24 @@ void Print_list(int local_A[], int local_n, int rank) {
  * Purpose:    Print each process' current list contents
  * Input args: all
  * Notes:
- * 1.  Assumes all participating processes are contributing local_n 
- *     elements
+ * 1.  The processes needn't all have the same local_n
  */
 void Print_local_lists(int local_A[], int local_n, 
          int my_rank, int p, MPI_Comm comm) {
    int*       A;
-   int        q;
+   int        q, q_n;
    MPI_Status status;
 
    if (my_rank == 0) {
-      A = (int*) malloc(local_n*sizeof(int));
       Print_list(local_A, local_n, my_rank);
       for (q = 1; q < p; q++) {
-         MPI_Recv(A, local_n, MPI_INT, q, 0, comm, &status);
-         Print_list(A, local_n, q);
+         MPI_Probe(q, 0, comm, &status);
+         MPI_Get_count(&status, MPI_INT, &q_n);
+         A = (int*) malloc(q_n*sizeof(int));
+         MPI_Recv(A, q_n, MPI_INT, q, 0, comm, &status);
+         Print_list(A, q_n, q);
+         free(A);
       }
-      free(A);
    } else {
       MPI_Send(local_A, local_n, MPI_INT, 0, 0, comm);
    }
@@ -9,8 +9,10 @@
  * Output:   Estimate of the integral from a to b of f(x)
  *           using the trapezoidal rule and n trapezoids.
  *
- * Compile:  mpicc -g -Wall -o mpi_trap4 mpi_trap4.c
- * Run:      mpiexec -n <number of processes> ./mpi_trap4
+ * Compile:  mpicc -g -Wall -o mpi_trap4 mpi_trap4.c -lm
+ *           (add -fopenmp for the -hybrid option)
+ * Run:      mpiexec -n <number of processes> ./mpi_trap4 [options]
+ *              options: see Common/trap_opts.h
  *
  * Algorithm:
  *    1.  Each process calculates "its" interval of
@@ -21,16 +23,83 @@
  *    3b. Process 0 sums the calculations received from
  *        the individual processes and prints the result.
  *
- * Note:  f(x) is all hardwired.
+ * Hybrid:  With -hybrid each process splits its interval among its
+ *        OpenMP threads (OMP_NUM_THREADS), so one process per node or
+ *        socket can use all of its cores.  The sum is then reduced
+ *        within each node onto a node leader, and the leaders reduce
+ *        onto process 0 (-reduce node).
+ *
+ * Reduce: The integrals and the process times are reduced together,
+ *        as (integral, time) pairs with a sum/max operator, using the
+ *        strategy picked by -reduce:
+ *           flat:  one MPI_Reduce (the default without -hybrid)
+ *           node:  MPI_Reduce within each shared memory node, then
+ *                  over the node leaders
+ *           rma:   MPI_Accumulate into a window on process 0
+ *           all:   time REDUCE_REPS runs of each and print a table
+ *        The communicators and window are set up before the timed
+ *        reduction, and the reported Time doesn't include it.
+ *
+ * Stream: With -stream <file> the jobs in file (format as for -batch)
+ *        are computed one after another by all the processes.  Each
+ *        job's sum goes to process 0 by MPI_Ireduce, so the reduction
+ *        of job k runs while job k+1 is computed, and process 0 prints
+ *        each result as soon as its reduction completes.
+ *
+ * Cumul: With -cumul <file> the processes write the cumulative integral
+ *        F(x) at every k-th grid point (-every k) to file.  Each
+ *        process computes the prefix sums of its block of points, an
+ *        MPI_Exscan of the block totals gives each process the integral
+ *        up to its block, and the processes write their fixed width
+ *        records straight to their own part of the file with MPI-IO.
+ *
+ * Dynamic: With -dynamic the trapezoids (or -rule panels) are cut into
+ *        chunks of -chunk k, which the processes take one at a time
+ *        until none are left, so fast processes and cheap parts of
+ *        [a, b] don't wait for slow ones.  With -dynamic rma the next
+ *        chunk is the value of a counter on process 0 that each
+ *        process increments with MPI_Fetch_and_op.  With -dynamic
+ *        master process 0 only hands out chunks, and each worker asks
+ *        for its next chunk before it computes the current one.
+ *
+ * Cache: With -cache <file> process 0 reads the cache (see
+ *        Common/cache.h) and broadcasts the list of lattice blocks that
+ *        aren't in it.  The processes split those blocks, process 0
+ *        collects their sums, adds the cached blocks and the partial
+ *        blocks at the ends, and appends the new entries to the file.
+ *
+ * Tab:   With -tab <file> the processes integrate the (x, y) samples in
+ *        file (see Common/tabdata.h).  Each process maps and reads only
+ *        its own slice of the file; the trapezoid between two slices
+ *        is closed by sending each slice's first sample to the process
+ *        before it, which overlaps the integration.
+ *
+ * Note:  f(x) is chosen at run time from the registry in
+ *        Common/integrands.h.  Trap's inner loop is compiled once per
+ *        integrand with f inlined.
  *
  * IPP:   Section 3.5 (pp. 117 and ff.)
  */
 #define _CRT_SECURE_NO_WARNINGS
 
 #include <stdio.h>
+#include <stddef.h>
 
 /* We'll be using MPI routines, definitions, etc. */
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define TRAP_OPTS_MPI
+#include "../Common/trap_opts.h"
+#include "../Common/adapt.h"
+#include "../Common/batch.h"
+#include "../Common/repro.h"
+#include "../Common/romberg.h"
+#include "../Common/cumul.h"
+#include "../Common/tabdata.h"
+#include "../Common/cache.h"
 
 /* Build a derived datatype for distributing the input data */
 void Build_mpi_type(double* a_p, double* b_p, int* n_p,
@@ -42,21 +111,107 @@ void Get_input(int my_rank, int comm_sz, double* a_p, double* b_p,
 
 /* Calculate local integral  */
 double Trap(double left_endpt, double right_endpt, int trap_count, 
-   double base_len);    
+   double base_len, const integrand_t* integrand);    
+
+/* Hybrid mode: local integral by OpenMP threads, two level reduce */
+double Hybrid_trap(double left_endpt, int trap_count, double base_len,
+   const integrand_t* integrand);
+double Hybrid_rule(const quad_rule_t* rule, double a, double panel_len,
+   int first, int last, const integrand_t* integrand);
+void Build_node_comms(MPI_Comm comm, MPI_Comm* node_comm_p,
+   MPI_Comm* leader_comm_p);
+
+/* Reduction strategies: each one adds up the processes' integrals
+ * and finds the largest of their times in a single reduction of
+ * (integral, time) pairs */
+#define REDUCE_REPS 100   /* Runs of each strategy with -reduce all */
+typedef struct {
+   MPI_Datatype pair_t;       /* (integral, time)                   */
+   MPI_Op       sum_max;      /* sum of integrals, max of times     */
+   MPI_Comm     node_comm;    /* node strategy, else MPI_COMM_NULL  */
+   MPI_Comm     leader_comm;
+   MPI_Win      win;          /* rma strategy, else MPI_WIN_NULL    */
+   double*      win_buf;      /* the window, on process 0           */
+} reducer_t;
+void Sum_max(void* in, void* inout, int* len, MPI_Datatype* type_p);
+void Reducer_init(reducer_t* r_p, int strategy, MPI_Comm comm);
+void Reducer_free(reducer_t* r_p);
+void Reduce_sum_max(reducer_t* r_p, int strategy, double local[],
+   double total[]);
+void Node_reduce(reducer_t* r_p, double local[], double total[]);
+void Rma_reduce(reducer_t* r_p, double local[], double total[]);
+void Time_reductions(reducer_t* r_p, double local[], double total[],
+   int my_rank);
+
+/* Calculate local integral by adaptive Simpson's rule */
+double Adapt_local(double a, double b, int n, double tol,
+   const integrand_t* integrand, int my_rank, int comm_sz,
+   long* evals_p);
+void Adapt_push(void* deque, const adapt_task_t* task_p);
+
+/* Dynamic mode: chunks of the trapezoids (or panels) on demand */
+#define DYNAMIC_REQUEST_TAG 1
+#define DYNAMIC_CHUNK_TAG   2
+double Chunk_integral(double a, double h, int first, int last,
+   const trap_opts_t* opts_p);
+double Dynamic_rma(double a, double h, int n, int chunk,
+   const trap_opts_t* opts_p, int my_rank);
+double Dynamic_master(double a, double h, int n, int chunk,
+   const trap_opts_t* opts_p, int my_rank, int comm_sz);
+
+/* Reproducible mode: the result doesn't depend on comm_sz */
+double Repro_trap(double a, double b, int n,
+   const integrand_t* integrand, int my_rank, int comm_sz);
+
+/* Romberg mode: reuse each level's sums for the next */
+void Romberg_trap(romberg_t* r_p, const integrand_t* integrand,
+   int my_rank, int comm_sz);
+
+/* Batch mode: compute every job in a file */
+void Build_job_type(MPI_Datatype* job_mpi_t_p);
+int Run_batch(const char* fname, int my_rank, int comm_sz);
+
+/* Cubature mode: 2D and 3D integrals over boxes */
+int Run_cubature(const cub_integrand_t* cub, int my_rank, int comm_sz);
 
-/* Function we're integrating */
-double f(double x); 
+/* (Quasi-)Monte Carlo mode: d-dimensional integrals over cubes */
+int Run_qmc(const trap_opts_t* opts_p, int my_rank, int comm_sz);
 
-int main(void) {
-   int my_rank, comm_sz, n, local_n;   
+/* Cumulative mode: F(x) at the grid points by a scan over processes */
+int Run_cumul(double a, double b, int n, const trap_opts_t* opts_p,
+      int my_rank, int comm_sz);
+
+/* Tabulated mode: each process maps only its own slice of the file */
+int Run_tab(const char* fname, int my_rank, int comm_sz);
+
+/* Cached mode: process 0 keeps the cache, all compute missing blocks */
+int Run_cached(double a, double b, int n, const trap_opts_t* opts_p,
+      int my_rank, int comm_sz);
+
+/* Streaming mode: overlap each job's reduction with the next job */
+#define STREAM_DEPTH 8   /* Most reductions in flight at once */
+int Run_stream(const char* fname, int my_rank, int comm_sz);
+int Bcast_jobs(const char* fname, int my_rank, batch_job_t** jobs_pp);
+
+int main(int argc, char* argv[]) {
+   int my_rank, comm_sz, n, local_n, first, last, chunk = 0;   
    double a, b, h, local_a, local_b;
-   double local_int, total_int;
+   double local_int = 0.0, total_int = 0.0;
    double local_beg,local_end;
    double local_time;
    double global_time;
+   trap_opts_t opts;
+   int status, provided, thread_count = 1;
+   long local_evals = 0, total_evals;
+   romberg_t romberg;
+   reducer_t reducer;
+   int strategy = -1;   /* No pair reduction */
+   double local_pair[2], total_pair[2];
+   double reduce_beg, reduce_time = 0.0;
 
-   /* Let the system do what it needs to start up MPI */
-   MPI_Init(NULL, NULL);
+   /* Let the system do what it needs to start up MPI.  Only the
+    * master thread of a process makes MPI calls in hybrid mode. */
+   MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
 
    /* Get my process rank */
    MPI_Comm_rank(MPI_COMM_WORLD, &my_rank);
@@ -64,36 +219,168 @@ int main(void) {
    /* Find out how many processes are being used */
    MPI_Comm_size(MPI_COMM_WORLD, &comm_sz);
 
+   /* Every process sees the same argv, so all of them parse it */
+   status = Get_trap_opts(argc, argv, 1, &opts, my_rank == 0);
+   if (status != 0) {
+      MPI_Finalize();
+      return status < 0;
+   }
+   if (opts.hybrid) {
+#     ifdef _OPENMP
+      thread_count = omp_get_max_threads();
+      if (my_rank == 0 && provided < MPI_THREAD_FUNNELED)
+         fprintf(stderr, "Warning: MPI doesn't support MPI_THREAD_FUNNELED\n");
+#     else
+      if (my_rank == 0)
+         fprintf(stderr, "-hybrid needs mpi_trap4 compiled with -fopenmp\n");
+      MPI_Finalize();
+      return 1;
+#     endif
+   }
+
+   if (opts.batch != NULL || opts.stream != NULL || opts.cub != NULL
+         || opts.qmc != NULL || opts.tab != NULL) {
+      if (opts.batch != NULL)
+         status = Run_batch(opts.batch, my_rank, comm_sz);
+      else if (opts.cub != NULL)
+         status = Run_cubature(opts.cub, my_rank, comm_sz);
+      else if (opts.qmc != NULL)
+         status = Run_qmc(&opts, my_rank, comm_sz);
+      else if (opts.tab != NULL)
+         status = Run_tab(opts.tab, my_rank, comm_sz);
+      else
+         status = Run_stream(opts.stream, my_rank, comm_sz);
+      MPI_Finalize();
+      return status;
+   }
+
    Get_input(my_rank, comm_sz, &a, &b, &n);
+   if (opts.cumul != NULL) {
+      status = Run_cumul(a, b, n, &opts, my_rank, comm_sz);
+      MPI_Finalize();
+      return status;
+   }
+   if (opts.cache != NULL && opts.tol <= 0.0 && opts.romberg <= 0
+         && !opts.repro && opts.dynamic < 0) {
+      status = Run_cached(a, b, n, &opts, my_rank, comm_sz);
+      MPI_Finalize();
+      return status;
+   }
 
    local_beg = MPI_Wtime();
 
-   h = (b-a)/n;          /* h is the same for all processes */
-   local_n = n/comm_sz;  /* So is the number of trapezoids  */
-
-   /* Length of each process' interval of
-    * integration = local_n*h.  So my interval
-    * starts at: */
-   local_a = a + my_rank*local_n*h;
-   local_b = local_a + local_n*h;
-   local_int = Trap(local_a, local_b, local_n, h);
+   if (opts.tol > 0.0) {
+      if (n < 1) n = comm_sz;
+      local_int = Adapt_local(a, b, n, opts.tol, opts.integrand,
+            my_rank, comm_sz, &local_evals);
+      MPI_Reduce(&local_evals, &total_evals, 1, MPI_LONG, MPI_SUM, 0,
+            MPI_COMM_WORLD);
+   } else if (opts.romberg > 0) {
+      Romberg_init(&romberg, a, b, n, opts.romberg);
+      Romberg_trap(&romberg, opts.integrand, my_rank, comm_sz);
+      total_int = romberg.R[romberg.level][romberg.level];
+   } else if (opts.repro) {
+      total_int = Repro_trap(a, b, n, opts.integrand, my_rank, comm_sz);
+   } else if (opts.dynamic >= 0) {
+      h = (b-a)/n;          /* Width of a trapezoid or panel */
+      chunk = opts.chunk > 0 ? opts.chunk : n/(DYNAMIC_CHUNKS*comm_sz);
+      if (chunk < 1) chunk = 1;
+      if (opts.dynamic == DYNAMIC_RMA)
+         local_int = Dynamic_rma(a, h, n, chunk, &opts, my_rank);
+      else
+         local_int = Dynamic_master(a, h, n, chunk, &opts, my_rank,
+               comm_sz);
+   } else if (opts.rule != NULL) {
+      h = (b-a)/n;          /* Width of a panel */
+      first = Repro_first(n, comm_sz, my_rank);
+      last = Repro_first(n, comm_sz, my_rank+1);
+      if (opts.hybrid)
+         local_int = Hybrid_rule(opts.rule, a, h, first, last,
+               opts.integrand);
+      else
+         local_int = Rule_sum(opts.rule, opts.integrand, a, h, first, last);
+   } else {
+      h = (b-a)/n;          /* h is the same for all processes */
+      local_n = n/comm_sz;  /* So is the number of trapezoids  */
 
-   /* Add up the integrals calculated by each process */
-   MPI_Reduce(&local_int, &total_int, 1, MPI_DOUBLE, MPI_SUM, 0,
-         MPI_COMM_WORLD);
+      /* Length of each process' interval of
+       * integration = local_n*h.  So my interval
+       * starts at: */
+      local_a = a + my_rank*local_n*h;
+      local_b = local_a + local_n*h;
+      if (opts.hybrid)
+         local_int = Hybrid_trap(local_a, local_n, h, opts.integrand);
+      else
+         local_int = Trap(local_a, local_b, local_n, h, opts.integrand);
+   }
 
    local_end = MPI_Wtime();
    local_time = local_end - local_beg;
 
-   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
-         MPI_COMM_WORLD);
+   /* Add up the integrals calculated by each process, and find the
+    * slowest process' time, in one reduction */
+   if (opts.tol <= 0.0 && (opts.romberg > 0 || opts.repro)) {
+      /* The integral is already on process 0 */
+      MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+            MPI_COMM_WORLD);
+   } else {
+      if (opts.reduce >= 0)
+         strategy = opts.reduce;
+      else
+         strategy = opts.hybrid ? REDUCE_NODE : REDUCE_FLAT;
+      Reducer_init(&reducer, strategy, MPI_COMM_WORLD);
+      local_pair[0] = local_int;
+      local_pair[1] = local_time;
+      if (strategy == REDUCE_ALL) {
+         Time_reductions(&reducer, local_pair, total_pair, my_rank);
+      } else {
+         reduce_beg = MPI_Wtime();
+         Reduce_sum_max(&reducer, strategy, local_pair, total_pair);
+         reduce_time = MPI_Wtime() - reduce_beg;
+      }
+      total_int = total_pair[0];
+      global_time = total_pair[1];
+      Reducer_free(&reducer);
+   }
 
    /* Print the result */
    if (my_rank == 0) {
-      printf("With n = %d trapezoids, our estimate\n", n);
-      printf("of the integral from %f to %f = %.15e\n",
-          a, b, total_int);
+      if (opts.tol > 0.0) {
+         printf("With adaptive Simpson, tol = %e, %ld evaluations of f,\n",
+             opts.tol, total_evals);
+         printf("our estimate\n");
+      } else if (opts.romberg > 0) {
+         Romberg_print(&romberg, stdout);
+         printf("\nWith Romberg extrapolation from n = %d to %d trapezoids,\n",
+             n, n << romberg.level);
+         printf("our estimate\n");
+      } else if (opts.repro) {
+         printf("With n = %d trapezoids (%s kernel, reproducible sum),\n",
+             n, trap_isa_names[opts.isa]);
+         printf("our estimate\n");
+      } else if (opts.dynamic >= 0) {
+         printf("With n = %d %s %s in chunks of %d (%s scheduling),\n",
+             n, opts.rule != NULL ? opts.rule->name : "trapezoid",
+             opts.rule != NULL ? "panels" : "rule", chunk,
+             dynamic_names[opts.dynamic]);
+         printf("our estimate\n");
+      } else if (opts.rule != NULL) {
+         printf("With n = %d %s panels (%s kernel), our estimate\n",
+             n, opts.rule->name, trap_isa_names[opts.isa]);
+      } else if (opts.hybrid) {
+         printf("With n = %d trapezoids (%s kernel, %d processes x %d threads),\n",
+             n, trap_isa_names[opts.isa], comm_sz, thread_count);
+         printf("our estimate\n");
+      } else {
+         printf("With n = %d trapezoids (%s kernel), our estimate\n",
+             n, trap_isa_names[opts.isa]);
+      }
+      printf("of the integral of %s from %f to %f = %.15e\n",
+          opts.integrand->formula, a, b, total_int);
 	  printf("\nTime: %fs\n",global_time);
+      if (strategy >= 0 && strategy != REDUCE_ALL)
+         printf("Reduce (%s): %es on process 0\n",
+               reduce_names[strategy], reduce_time);
    }
 
    /* Shut down MPI */
@@ -170,6 +457,7 @@ void Get_input(
  *               right_endpt
  *               trap_count 
  *               base_len
+ *               integrand
  * Return val:   Trapezoidal rule estimate of integral from
  *               left_endpt to right_endpt using trap_count
  *               trapezoids
@@ -178,26 +466,1029 @@ double Trap(
       double left_endpt  /* in */, 
       double right_endpt /* in */, 
       int    trap_count  /* in */, 
-      double base_len    /* in */) {
-   double estimate, x; 
-   int i;
+      double base_len    /* in */,
+      const integrand_t* integrand /* in */) {
+   double estimate; 
 
-   estimate = (f(left_endpt) + f(right_endpt))/2.0;
-   for (i = 1; i <= trap_count-1; i++) {
-      x = left_endpt + i*base_len;
-      estimate += f(x);
-   }
+   estimate = (integrand->f(left_endpt) + integrand->f(right_endpt))/2.0;
+   estimate += integrand->sum(left_endpt, base_len, 1, trap_count-1);
    estimate = estimate*base_len;
 
    return estimate;
 } /*  Trap  */
 
+/*------------------------------------------------------------------
+ * Function:     Hybrid_trap
+ * Purpose:      Trapezoidal rule over this process' trapezoids, split
+ *               into contiguous blocks among its OpenMP threads
+ * Input args:   left_endpt, trap_count, base_len, integrand
+ * Return val:   Estimate of the integral over this process' interval
+ */
+double Hybrid_trap(
+      double left_endpt  /* in */,
+      int    trap_count  /* in */,
+      double base_len    /* in */,
+      const integrand_t* integrand /* in */) {
+   double estimate = 0.0;
+
+#  ifdef _OPENMP
+#  pragma omp parallel reduction(+: estimate)
+   {
+      int my_thread = omp_get_thread_num();
+      int threads = omp_get_num_threads();
+      int first = Repro_first(trap_count, threads, my_thread);
+      int last = Repro_first(trap_count, threads, my_thread+1);
+
+      /* Thread t takes the trapezoids first <= i < last: their
+       * interior points, and the left endpoint weighted 1/2 or 1 */
+      estimate = integrand->sum(left_endpt, base_len, first+1, last-1);
+      if (last > first)
+         estimate += (first == 0 ? 0.5 : 1.0)
+               *integrand->f(left_endpt + first*base_len);
+      if (my_thread == threads-1)
+         estimate += 0.5*integrand->f(left_endpt + trap_count*base_len);
+   }
+#  else
+   estimate = integrand->sum(left_endpt, base_len, 1, trap_count-1)
+      + (integrand->f(left_endpt)
+         + integrand->f(left_endpt + trap_count*base_len))/2.0;
+#  endif
+
+   return estimate*base_len;
+}  /* Hybrid_trap */
+
+/*------------------------------------------------------------------
+ * Function:     Hybrid_rule
+ * Purpose:      Apply rule to this process' panels first <= p < last,
+ *               split into contiguous blocks among its OpenMP threads
+ * Input args:   rule, a, panel_len, first, last, integrand
+ * Return val:   Estimate of the integral over this process' panels
+ */
+double Hybrid_rule(
+      const quad_rule_t* rule  /* in */,
+      double a                 /* in */,
+      double panel_len         /* in */,
+      int    first             /* in */,
+      int    last              /* in */,
+      const integrand_t* integrand /* in */) {
+   double estimate = 0.0;
+
+#  ifdef _OPENMP
+#  pragma omp parallel reduction(+: estimate)
+   {
+      int my_thread = omp_get_thread_num();
+      int threads = omp_get_num_threads();
+
+      estimate = Rule_sum(rule, integrand, a, panel_len,
+            first + Repro_first(last - first, threads, my_thread),
+            first + Repro_first(last - first, threads, my_thread+1));
+   }
+#  else
+   estimate = Rule_sum(rule, integrand, a, panel_len, first, last);
+#  endif
+
+   return estimate;
+}  /* Hybrid_rule */
+
+/*------------------------------------------------------------------
+ * Function:     Chunk_integral
+ * Purpose:      Integral over the trapezoids (or panels, with -rule)
+ *               first <= i < last of width h starting at a, using this
+ *               process' OpenMP threads with -hybrid
+ */
+double Chunk_integral(
+      double a                   /* in */,
+      double h                   /* in */,
+      int    first               /* in */,
+      int    last                /* in */,
+      const trap_opts_t* opts_p  /* in */) {
+   if (opts_p->rule != NULL && opts_p->hybrid)
+      return Hybrid_rule(opts_p->rule, a, h, first, last,
+            opts_p->integrand);
+   if (opts_p->rule != NULL)
+      return Rule_sum(opts_p->rule, opts_p->integrand, a, h, first, last);
+   if (opts_p->hybrid)
+      return Hybrid_trap(a + first*h, last - first, h, opts_p->integrand);
+   return Trap(a + first*h, a + last*h, last - first, h,
+         opts_p->integrand);
+}  /* Chunk_integral */
+
+/*------------------------------------------------------------------
+ * Function:     Dynamic_rma
+ * Purpose:      Take chunks of the n trapezoids by incrementing a
+ *               counter in a window on process 0 with MPI_Fetch_and_op,
+ *               and integrate them until the counter passes the last
+ *               chunk.  Collective over MPI_COMM_WORLD.
+ * Input args:   a, h, n, chunk, opts_p, my_rank
+ * Return val:   The sum of the integrals over this process' chunks
+ */
+double Dynamic_rma(
+      double a                   /* in */,
+      double h                   /* in */,
+      int    n                   /* in */,
+      int    chunk               /* in */,
+      const trap_opts_t* opts_p  /* in */,
+      int    my_rank             /* in */) {
+   int chunk_count = (n + chunk - 1)/chunk;
+   int one = 1, next, first;
+   int* counter;
+   MPI_Win win;
+   double estimate = 0.0;
+
+   MPI_Win_allocate(my_rank == 0 ? sizeof(int) : 0, sizeof(int),
+         MPI_INFO_NULL, MPI_COMM_WORLD, &counter, &win);
+   if (my_rank == 0) {
+      MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, win);
+      *counter = 0;
+      MPI_Win_unlock(0, win);
+   }
+   MPI_Barrier(MPI_COMM_WORLD);
+
+   MPI_Win_lock_all(0, win);
+   for (;;) {
+      MPI_Fetch_and_op(&one, &next, MPI_INT, 0, 0, MPI_SUM, win);
+      MPI_Win_flush(0, win);
+      if (next >= chunk_count) break;
+      first = next*chunk;
+      estimate += Chunk_integral(a, h, first,
+            first + chunk < n ? first + chunk : n, opts_p);
+   }
+   MPI_Win_unlock_all(win);
+
+   MPI_Win_free(&win);
+   return estimate;
+}  /* Dynamic_rma */
+
+/*------------------------------------------------------------------
+ * Function:     Dynamic_master
+ * Purpose:      Process 0 hands out chunks of the n trapezoids, in
+ *               order, to the workers that ask for one, and answers -1
+ *               when there are none left.  Each worker asks for its
+ *               next chunk before integrating the current one, so the
+ *               round trip is hidden behind the computation.  With one
+ *               process, process 0 integrates all the chunks itself.
+ * Input args:   a, h, n, chunk, opts_p, my_rank, comm_sz
+ * Return val:   The sum of the integrals over this process' chunks
+ */
+double Dynamic_master(
+      double a                   /* in */,
+      double h                   /* in */,
+      int    n                   /* in */,
+      int    chunk               /* in */,
+      const trap_opts_t* opts_p  /* in */,
+      int    my_rank             /* in */,
+      int    comm_sz             /* in */) {
+   int chunk_count = (n + chunk - 1)/chunk;
+   int next = 0, current, first, stopped = 0;
+   MPI_Status status;
+   MPI_Request requests[2];
+   double estimate = 0.0;
+
+   if (comm_sz == 1)
+      return Chunk_integral(a, h, 0, n, opts_p);
+
+   if (my_rank == 0) {
+      while (stopped < comm_sz - 1) {
+         MPI_Recv(NULL, 0, MPI_INT, MPI_ANY_SOURCE, DYNAMIC_REQUEST_TAG,
+               MPI_COMM_WORLD, &status);
+         current = next < chunk_count ? next++ : -1;
+         if (current < 0) stopped++;
+         MPI_Send(&current, 1, MPI_INT, status.MPI_SOURCE,
+               DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD);
+      }
+      return 0.0;
+   }
+
+   MPI_Send(NULL, 0, MPI_INT, 0, DYNAMIC_REQUEST_TAG, MPI_COMM_WORLD);
+   MPI_Recv(&current, 1, MPI_INT, 0, DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD,
+         MPI_STATUS_IGNORE);
+   while (current >= 0) {
+      MPI_Isend(NULL, 0, MPI_INT, 0, DYNAMIC_REQUEST_TAG, MPI_COMM_WORLD,
+            &requests[0]);
+      MPI_Irecv(&next, 1, MPI_INT, 0, DYNAMIC_CHUNK_TAG, MPI_COMM_WORLD,
+            &requests[1]);
+      first = current*chunk;
+      estimate += Chunk_integral(a, h, first,
+            first + chunk < n ? first + chunk : n, opts_p);
+      MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+      current = next;
+   }
+   return estimate;
+}  /* Dynamic_master */
+
+/*------------------------------------------------------------------
+ * Function:     Build_node_comms
+ * Purpose:      Split comm into one communicator per shared memory
+ *               node, and one communicator of the node leaders (rank 0
+ *               on each node)
+ * Input args:   comm
+ * Output args:  node_comm_p:    the processes on my node
+ *               leader_comm_p:  the node leaders, or MPI_COMM_NULL if
+ *                               I'm not a leader
+ * Note:         Process 0 of comm is process 0 of both communicators
+ *               it belongs to.
+ */
+void Build_node_comms(
+      MPI_Comm   comm           /* in  */,
+      MPI_Comm*  node_comm_p    /* out */,
+      MPI_Comm*  leader_comm_p  /* out */) {
+   int my_rank, node_rank;
+
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, my_rank,
+         MPI_INFO_NULL, node_comm_p);
+   MPI_Comm_rank(*node_comm_p, &node_rank);
+   MPI_Comm_split(comm, node_rank == 0 ? 0 : MPI_UNDEFINED, my_rank,
+         leader_comm_p);
+}  /* Build_node_comms */
+
+/*------------------------------------------------------------------
+ * Function:     Sum_max
+ * Purpose:      MPI_Op on (integral, time) pairs: add the integrals
+ *               and keep the larger time
+ * Input args:   in, len, type_p (unused: always pair_t)
+ * In/out args:  inout
+ */
+void Sum_max(
+      void*          in      /* in     */,
+      void*          inout   /* in/out */,
+      int*           len     /* in     */,
+      MPI_Datatype*  type_p  /* in     */) {
+   double* x = (double*) in;
+   double* y = (double*) inout;
+   int i;
+
+   (void) type_p;   /* always pair_t */
+   for (i = 0; i < *len; i++) {
+      y[2*i] += x[2*i];
+      if (x[2*i+1] > y[2*i+1]) y[2*i+1] = x[2*i+1];
+   }
+}  /* Sum_max */
+
+/*------------------------------------------------------------------
+ * Function:     Reducer_init
+ * Purpose:      Set up what a reduction strategy needs: the pair
+ *               datatype and operator for all of them, the node and
+ *               leader communicators for node, and a window on
+ *               process 0 for rma.  Collective over comm.
+ * Input args:   strategy, comm
+ * Output args:  r_p
+ */
+void Reducer_init(
+      reducer_t*  r_p       /* out */,
+      int         strategy  /* in  */,
+      MPI_Comm    comm      /* in  */) {
+   int my_rank;
+
+   MPI_Comm_rank(comm, &my_rank);
+   MPI_Type_contiguous(2, MPI_DOUBLE, &r_p->pair_t);
+   MPI_Type_commit(&r_p->pair_t);
+   MPI_Op_create(Sum_max, 1, &r_p->sum_max);
+
+   r_p->node_comm = r_p->leader_comm = MPI_COMM_NULL;
+   if (strategy == REDUCE_NODE || strategy == REDUCE_ALL)
+      Build_node_comms(comm, &r_p->node_comm, &r_p->leader_comm);
+
+   r_p->win = MPI_WIN_NULL;
+   r_p->win_buf = NULL;
+   if (strategy == REDUCE_RMA || strategy == REDUCE_ALL)
+      MPI_Win_allocate(my_rank == 0 ? 2*sizeof(double) : 0,
+            sizeof(double), MPI_INFO_NULL, comm, &r_p->win_buf,
+            &r_p->win);
+   if (my_rank != 0) r_p->win_buf = NULL;
+}  /* Reducer_init */
+
+/*------------------------------------------------------------------
+ * Function:     Reducer_free
+ */
+void Reducer_free(reducer_t* r_p /* in/out */) {
+   if (r_p->win != MPI_WIN_NULL) MPI_Win_free(&r_p->win);
+   if (r_p->node_comm != MPI_COMM_NULL) MPI_Comm_free(&r_p->node_comm);
+   if (r_p->leader_comm != MPI_COMM_NULL)
+      MPI_Comm_free(&r_p->leader_comm);
+   MPI_Op_free(&r_p->sum_max);
+   MPI_Type_free(&r_p->pair_t);
+}  /* Reducer_free */
+
+/*------------------------------------------------------------------
+ * Function:     Reduce_sum_max
+ * Purpose:      Reduce the (integral, time) pairs onto process 0
+ *               with one strategy (not REDUCE_ALL)
+ * Input args:   r_p:    set up by Reducer_init for strategy
+ *               strategy, local
+ * Output args:  total:  valid on process 0
+ */
+void Reduce_sum_max(
+      reducer_t*  r_p       /* in  */,
+      int         strategy  /* in  */,
+      double      local[]   /* in  */,
+      double      total[]   /* out */) {
+   if (strategy == REDUCE_NODE)
+      Node_reduce(r_p, local, total);
+   else if (strategy == REDUCE_RMA)
+      Rma_reduce(r_p, local, total);
+   else
+      MPI_Reduce(local, total, 1, r_p->pair_t, r_p->sum_max, 0,
+            MPI_COMM_WORLD);
+}  /* Reduce_sum_max */
+
+/*------------------------------------------------------------------
+ * Function:     Node_reduce
+ * Purpose:      Reduce the pairs first onto each node leader through
+ *               shared memory, then over the leaders onto process 0
+ * Input args:   r_p, local
+ * Output args:  total:  valid on process 0
+ */
+void Node_reduce(
+      reducer_t*  r_p      /* in  */,
+      double      local[]  /* in  */,
+      double      total[]  /* out */) {
+   double node[2] = {0.0, 0.0};
+
+   MPI_Reduce(local, node, 1, r_p->pair_t, r_p->sum_max, 0,
+         r_p->node_comm);
+   if (r_p->leader_comm != MPI_COMM_NULL)
+      MPI_Reduce(node, total, 1, r_p->pair_t, r_p->sum_max, 0,
+            r_p->leader_comm);
+}  /* Node_reduce */
+
+/*------------------------------------------------------------------
+ * Function:     Rma_reduce
+ * Purpose:      Every process adds its integral to, and maxes its time
+ *               into, the window on process 0 with MPI_Accumulate,
+ *               between two fences.  (User defined ops like sum_max
+ *               can't be used with MPI_Accumulate.)
+ * Input args:   r_p, local
+ * Output args:  total:  valid on process 0
+ */
+void Rma_reduce(
+      reducer_t*  r_p      /* in  */,
+      double      local[]  /* in  */,
+      double      total[]  /* out */) {
+   if (r_p->win_buf != NULL)
+      r_p->win_buf[0] = r_p->win_buf[1] = 0.0;
+   MPI_Win_fence(MPI_MODE_NOPRECEDE, r_p->win);
+   MPI_Accumulate(&local[0], 1, MPI_DOUBLE, 0, 0, 1, MPI_DOUBLE, MPI_SUM,
+         r_p->win);
+   MPI_Accumulate(&local[1], 1, MPI_DOUBLE, 0, 1, 1, MPI_DOUBLE, MPI_MAX,
+         r_p->win);
+   MPI_Win_fence(MPI_MODE_NOSUCCEED, r_p->win);
+   if (r_p->win_buf != NULL) {
+      total[0] = r_p->win_buf[0];
+      total[1] = r_p->win_buf[1];
+   }
+}  /* Rma_reduce */
+
+/*------------------------------------------------------------------
+ * Function:     Time_reductions
+ * Purpose:      Run every strategy REDUCE_REPS times on the same pairs
+ *               and print the mean time of each (the largest over the
+ *               processes)
+ * Input args:   r_p:    set up by Reducer_init for REDUCE_ALL
+ *               local, my_rank
+ * Output args:  total:  result of the flat strategy, on process 0
+ */
+void Time_reductions(
+      reducer_t*  r_p      /* in  */,
+      double      local[]  /* in  */,
+      double      total[]  /* out */,
+      int         my_rank  /* in  */) {
+   int strategy, rep;
+   double beg, elapsed, max_elapsed, check[2];
+
+   if (my_rank == 0)
+      printf("Strategy  Time per reduction (mean of %d)\n", REDUCE_REPS);
+   for (strategy = REDUCE_FLAT; strategy < REDUCE_ALL; strategy++) {
+      MPI_Barrier(MPI_COMM_WORLD);
+      beg = MPI_Wtime();
+      for (rep = 0; rep < REDUCE_REPS; rep++)
+         Reduce_sum_max(r_p, strategy, local,
+               strategy == REDUCE_FLAT ? total : check);
+      elapsed = (MPI_Wtime() - beg)/REDUCE_REPS;
+      MPI_Reduce(&elapsed, &max_elapsed, 1, MPI_DOUBLE, MPI_MAX, 0,
+            MPI_COMM_WORLD);
+      if (my_rank == 0)
+         printf("%-8s  %es\n", reduce_names[strategy], max_elapsed);
+   }
+}  /* Time_reductions */
+
+/*------------------------------------------------------------------
+ * Function:     Romberg_trap
+ * Purpose:      Fill in a Romberg table.  At each level the new
+ *               midpoints are split into one block per process, and
+ *               the block sums are reduced onto process 0.
+ * Input args:   integrand, my_rank, comm_sz
+ * In/out args:  r_p:  initialized by Romberg_init; the table is only
+ *                     valid on process 0
+ */
+void Romberg_trap(
+      romberg_t*  r_p       /* in/out */,
+      const integrand_t* integrand /* in */,
+      int         my_rank   /* in */,
+      int         comm_sz   /* in */) {
+   double h = (r_p->b - r_p->a)/r_p->n;
+   double x0 = r_p->a + h, step = h;
+   int count = r_p->n - 1;
+   int first, last;
+   double local_sum, level_sum = 0.0;
+
+   do {
+      first = Repro_first(count, comm_sz, my_rank);
+      last = Repro_first(count, comm_sz, my_rank+1);
+      local_sum = integrand->sum(x0, step, first, last-1);
+      if (r_p->level < 0 && my_rank == 0)
+         local_sum += (integrand->f(r_p->a) + integrand->f(r_p->b))/2.0;
+      MPI_Reduce(&local_sum, &level_sum, 1, MPI_DOUBLE, MPI_SUM, 0,
+            MPI_COMM_WORLD);
+      Romberg_add(r_p, level_sum);
+   } while (Romberg_next(r_p, &x0, &step, &count));
+}  /* Romberg_trap */
+
+/*------------------------------------------------------------------
+ * Function:     Adapt_local
+ * Purpose:      Adaptive Simpson's rule over this process' panels
+ * Input args:   a, b:       endpoints of the whole interval
+ *               n:          number of panels [a, b] is cut into
+ *               tol:        error allowed over [a, b]
+ *               integrand, my_rank, comm_sz
+ * Output args:  evals_p:    number of evaluations of f
+ * Return val:   Estimate of the integral over my panels
+ * Note:         Panels are dealt out cyclically rather than in one
+ *               block per process, so a region that needs a lot of
+ *               refinement is shared by several processes.  Tasks
+ *               are not moved between processes.
+ */
+double Adapt_local(
+      double  a         /* in  */,
+      double  b         /* in  */,
+      int     n         /* in  */,
+      double  tol       /* in  */,
+      const integrand_t* integrand /* in */,
+      int     my_rank   /* in  */,
+      int     comm_sz   /* in  */,
+      long*   evals_p   /* out */) {
+   adapt_deque_t deque;
+   adapt_task_t task;
+   double estimate = 0.0;
+   int i;
+
+   *evals_p = 0;
+   Adapt_deque_init(&deque);
+   for (i = my_rank; i < n; i += comm_sz) {
+      Adapt_first_task(integrand, a, b, n, i, tol, &task, evals_p);
+      Adapt_deque_push(&deque, &task);
+   }
+   while (Adapt_deque_pop(&deque, &task))
+      estimate += Adapt_run(integrand, task, Adapt_push, &deque, evals_p);
+   Adapt_deque_free(&deque);
+
+   return estimate;
+}  /* Adapt_local */
+
+/*------------------------------------------------------------------
+ * Function:     Adapt_push
+ * Purpose:      Put a task on my deque
+ */
+void Adapt_push(void* deque, const adapt_task_t* task_p) {
+   Adapt_deque_push((adapt_deque_t*) deque, task_p);
+}  /* Adapt_push */
 
 /*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input args:  x
+ * Function:     Build_job_type
+ * Purpose:      Build a derived datatype for batch_job_t so the whole
+ *               batch can be broadcast in one message
+ * Output args:  job_mpi_t_p:  the new MPI datatype
  */
-double f(double x /* in */) {
-   return x*x;
-} /* f */
+void Build_job_type(MPI_Datatype* job_mpi_t_p /* out */) {
+   int array_of_blocklengths[3] = {1, 2, 1};
+   MPI_Datatype array_of_types[3] = {MPI_INT, MPI_DOUBLE, MPI_INT};
+   MPI_Aint array_of_displacements[3] = {offsetof(batch_job_t, integrand),
+         offsetof(batch_job_t, a), offsetof(batch_job_t, n)};
+   MPI_Datatype struct_t;
+   MPI_Aint extent;
+
+   MPI_Type_create_struct(3, array_of_blocklengths,
+         array_of_displacements, array_of_types, &struct_t);
+
+   /* Make the extent match sizeof, including trailing padding */
+   extent = sizeof(batch_job_t);
+   MPI_Type_create_resized(struct_t, 0, extent, job_mpi_t_p);
+   MPI_Type_commit(job_mpi_t_p);
+   MPI_Type_free(&struct_t);
+}  /* Build_job_type */
+
+/*------------------------------------------------------------------
+ * Function:     Run_batch
+ * Purpose:      Compute every job in a batch file.  Process 0 reads
+ *               the file and broadcasts it, the jobs are dealt out
+ *               cyclically, each computed serially by one process,
+ *               and one reduction brings all the results to process 0
+ *               in file order.
+ * Input args:   fname, my_rank, comm_sz
+ * Return val:   0 on success, 1 if process 0 couldn't read the file
+ */
+int Run_batch(
+      const char* fname    /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   batch_job_t* jobs = NULL;
+   double *local_results, *results = NULL;
+   int i, count;
+   double local_beg, local_time, global_time;
+
+   local_beg = MPI_Wtime();
+   count = Bcast_jobs(fname, my_rank, &jobs);
+   if (count < 0) return 1;
+
+   local_results = (double*) calloc(count, sizeof(double));
+   for (i = my_rank; i < count; i += comm_sz)
+      local_results[i] = Batch_trap(&jobs[i]);
+
+   if (my_rank == 0)
+      results = (double*) malloc(count*sizeof(double));
+   MPI_Reduce(local_results, results, count, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      Print_batch(jobs, results, count);
+      printf("\n%d jobs, time: %fs\n", count, global_time);
+      free(results);
+   }
+   free(local_results);
+   free(jobs);
+   return 0;
+}  /* Run_batch */
+
+/*------------------------------------------------------------------
+ * Function:     Repro_trap
+ * Purpose:      Trapezoidal rule whose result doesn't depend on
+ *               comm_sz.  Each process computes a block of the leaves
+ *               of repro.h, the leaves are gathered onto process 0 in
+ *               order, and process 0 adds them by a fixed tree.
+ * Input args:   a, b, n, integrand, my_rank, comm_sz
+ * Return val:   Estimate of the integral on process 0, 0 elsewhere
+ */
+double Repro_trap(
+      double  a         /* in */,
+      double  b         /* in */,
+      int     n         /* in */,
+      const integrand_t* integrand /* in */,
+      int     my_rank   /* in */,
+      int     comm_sz   /* in */) {
+   int leaf_count = Repro_leaf_count(n);
+   int first = Repro_first(leaf_count, comm_sz, my_rank);
+   int my_count = Repro_first(leaf_count, comm_sz, my_rank+1) - first;
+   double h = (b-a)/n;
+   double *local_leaves, *leaves = NULL;
+   int *counts = NULL, *displs = NULL;
+   double estimate = 0.0;
+   int j, q;
+
+   local_leaves = (double*) malloc((my_count > 0 ? my_count : 1)
+         *sizeof(double));
+   for (j = 0; j < my_count; j++)
+      local_leaves[j] = Repro_leaf(integrand, a, h, n, leaf_count,
+            first + j);
+
+   if (my_rank == 0) {
+      leaves = (double*) malloc(leaf_count*sizeof(double));
+      counts = (int*) malloc(comm_sz*sizeof(int));
+      displs = (int*) malloc(comm_sz*sizeof(int));
+      for (q = 0; q < comm_sz; q++) {
+         displs[q] = Repro_first(leaf_count, comm_sz, q);
+         counts[q] = Repro_first(leaf_count, comm_sz, q+1) - displs[q];
+      }
+   }
+   MPI_Gatherv(local_leaves, my_count, MPI_DOUBLE, leaves, counts,
+         displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      estimate = Pairwise_sum(leaves, leaf_count);
+      free(leaves);
+      free(counts);
+      free(displs);
+   }
+   free(local_leaves);
+
+   return estimate;
+}  /* Repro_trap */
+
+/*------------------------------------------------------------------
+ * Function:     Bcast_jobs
+ * Purpose:      Process 0 reads a job file, and the jobs are broadcast
+ *               to every process in one message
+ * Input args:   fname, my_rank
+ * Output args:  jobs_pp:  newly allocated array of jobs
+ * Return val:   Number of jobs, or -1 (on every process) if process 0
+ *               couldn't read the file
+ */
+int Bcast_jobs(
+      const char*    fname    /* in  */,
+      int            my_rank  /* in  */,
+      batch_job_t**  jobs_pp  /* out */) {
+   int count;
+   MPI_Datatype job_mpi_t;
+
+   if (my_rank == 0 && Read_batch(fname, jobs_pp, &count) != 0)
+      count = -1;
+   MPI_Bcast(&count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (count < 0) return -1;
+
+   if (my_rank != 0)
+      *jobs_pp = (batch_job_t*) malloc(count*sizeof(batch_job_t));
+   Build_job_type(&job_mpi_t);
+   MPI_Bcast(*jobs_pp, count, job_mpi_t, 0, MPI_COMM_WORLD);
+   MPI_Type_free(&job_mpi_t);
+
+   return count;
+}  /* Bcast_jobs */
+
+/*------------------------------------------------------------------
+ * Function:     Run_stream
+ * Purpose:      Compute the jobs in a file one after another, each
+ *               split across all the processes in blocks of trapezoids
+ *               whose sizes differ by at most one.  Job k's sum is
+ *               started on its way to process 0 with MPI_Ireduce and
+ *               job k+1 is computed while it travels.  At most
+ *               STREAM_DEPTH reductions are in flight; process 0 prints
+ *               results in order as their reductions complete.
+ * Input args:   fname, my_rank, comm_sz
+ * Return val:   0 on success, 1 if process 0 couldn't read the file
+ */
+int Run_stream(
+      const char* fname    /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   batch_job_t* jobs = NULL;
+   double *local_ints, *total_ints;
+   MPI_Request requests[STREAM_DEPTH];
+   int k, done, flag, count, first, last;
+   double h, local_a, local_b;
+   double local_beg, local_time, global_time;
+
+   count = Bcast_jobs(fname, my_rank, &jobs);
+   if (count < 0) return 1;
+   local_ints = (double*) malloc(count*sizeof(double));
+   total_ints = (double*) malloc(count*sizeof(double));
+
+   local_beg = MPI_Wtime();
+   done = 0;
+   for (k = 0; k < count; k++) {
+      /* Free a slot for job k's reduction */
+      if (k - done == STREAM_DEPTH) {
+         MPI_Wait(&requests[done % STREAM_DEPTH], MPI_STATUS_IGNORE);
+         if (my_rank == 0) Print_batch(&jobs[done], &total_ints[done], 1);
+         done++;
+      }
+
+      h = (jobs[k].b - jobs[k].a)/jobs[k].n;
+      first = Repro_first(jobs[k].n, comm_sz, my_rank);
+      last = Repro_first(jobs[k].n, comm_sz, my_rank+1);
+      local_a = jobs[k].a + first*h;
+      local_b = jobs[k].a + last*h;
+      /* With fewer trapezoids than processes some get none */
+      if (last > first)
+         local_ints[k] = Trap(local_a, local_b, last - first, h,
+               &integrands[jobs[k].integrand]);
+      else
+         local_ints[k] = 0.0;
+      MPI_Ireduce(&local_ints[k], &total_ints[k], 1, MPI_DOUBLE,
+            MPI_SUM, 0, MPI_COMM_WORLD, &requests[k % STREAM_DEPTH]);
+
+      /* Emit whatever has already arrived, and give MPI a chance to
+       * progress the reductions in flight */
+      for (flag = 1; flag && done <= k; ) {
+         MPI_Test(&requests[done % STREAM_DEPTH], &flag, MPI_STATUS_IGNORE);
+         if (flag) {
+            if (my_rank == 0) Print_batch(&jobs[done], &total_ints[done], 1);
+            done++;
+         }
+      }
+   }
+   for (; done < count; done++) {
+      MPI_Wait(&requests[done % STREAM_DEPTH], MPI_STATUS_IGNORE);
+      if (my_rank == 0) Print_batch(&jobs[done], &total_ints[done], 1);
+   }
+
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+   if (my_rank == 0)
+      printf("\n%d jobs, time: %fs\n", count, global_time);
+
+   free(local_ints);
+   free(total_ints);
+   free(jobs);
+   return 0;
+}  /* Run_stream */
+
+/*------------------------------------------------------------------
+ * Function:     Run_cubature
+ * Purpose:      Integrate a 2D or 3D integrand over a box read by
+ *               process 0.  The tiles of the grid are dealt out
+ *               cyclically, so every process gets tiles from all over
+ *               the box, and the tile sums are reduced onto process 0.
+ * Input args:   cub, my_rank, comm_sz
+ * Return val:   0 on success, 1 if process 0 got bad input
+ */
+int Run_cubature(
+      const cub_integrand_t* cub /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   double a[3], b[3];
+   int n[3];
+   cub_grid_t grid;
+   long tile, tile_count;
+   double local_sum = 0.0, total_sum = 0.0;
+   double local_beg, local_time, global_time;
+
+   if (my_rank == 0 && Read_cub_box(cub->dims, a, b, n) != 0)
+      n[0] = -1;
+   MPI_Bcast(n, 3, MPI_INT, 0, MPI_COMM_WORLD);
+   if (n[0] < 1) return 1;
+   MPI_Bcast(a, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(b, 3, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   Cub_grid_init(&grid, cub->dims, a, b, n);
+   tile_count = Cub_tile_count(&grid);
+
+   local_beg = MPI_Wtime();
+   for (tile = my_rank; tile < tile_count; tile += comm_sz)
+      local_sum += Cub_tile(cub, &grid, tile);
+   MPI_Reduce(&local_sum, &total_sum, 1, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      Print_cub_result(cub, &grid, total_sum*Cub_cell_volume(&grid));
+      printf("\nTime: %fs\n", global_time);
+   }
+   return 0;
+}  /* Run_cubature */
+
+/*------------------------------------------------------------------
+ * Function:     Run_qmc
+ * Purpose:      Integrate a d-dimensional integrand over [a, b]^d read
+ *               by process 0.  Every point is a function of its index
+ *               alone, so each process makes and evaluates its own
+ *               block of the samples with no communication, and the
+ *               sums of f and f^2 are reduced onto process 0.
+ * Input args:   opts_p, my_rank, comm_sz
+ * Return val:   0 on success, 1 if process 0 got bad input
+ */
+int Run_qmc(
+      const trap_opts_t* opts_p  /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   int dims = 0;
+   double box[2];
+   long long samples;
+   qmc_gen_t gen;
+   double local_sums[2] = {0.0, 0.0}, total_sums[2] = {0.0, 0.0};
+   double local_beg, local_time, global_time;
+
+   if (my_rank == 0
+         && Read_qmc_input(opts_p->seq, &dims, &box[0], &box[1],
+            &samples) != 0)
+      dims = -1;
+   MPI_Bcast(&dims, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (dims < 1) return 1;
+   MPI_Bcast(box, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+   MPI_Bcast(&samples, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+   Qmc_init(&gen, opts_p->seq, dims, box[0], box[1], opts_p->seed);
+
+   local_beg = MPI_Wtime();
+   Qmc_sum(opts_p->qmc, &gen, Repro_first(samples, comm_sz, my_rank),
+         Repro_first(samples, comm_sz, my_rank+1),
+         &local_sums[0], &local_sums[1]);
+   MPI_Reduce(local_sums, total_sums, 2, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      Print_qmc_result(opts_p->qmc, &gen, samples, total_sums[0],
+            total_sums[1]);
+      printf("\nTime: %fs\n", global_time);
+   }
+   return 0;
+}  /* Run_qmc */
+
+/*------------------------------------------------------------------
+ * Function:     Run_cumul
+ * Purpose:      Write the cumulative integral at every k-th grid point
+ *               to opts_p->cumul (see cumul.h).  The output points are
+ *               split into one block per process; the second pass of
+ *               the scan gets its offsets from MPI_Exscan, and every
+ *               process writes its block's records at its own offset.
+ * Input args:   a, b, n:  as for Trap, on every process
+ *               opts_p, my_rank, comm_sz
+ * Return val:   0 on success, 1 on bad input or if the file can't be
+ *               written
+ */
+int Run_cumul(
+      double      a        /* in */,
+      double      b        /* in */,
+      int         n        /* in */,
+      const trap_opts_t* opts_p /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   const integrand_t* integrand = opts_p->integrand;
+   int k = opts_p->every;
+   double h = (b-a)/n;
+   int points, j0, j1, error, max_error;
+   double* values;
+   char* buf;
+   double local_total, offset = 0.0, total;
+   double local_beg, local_time, global_time;
+   MPI_Datatype record_t;
+   MPI_File fh;
+
+   if (n < 1) return 1;
+   points = Cumul_point_count(n, k);
+   j0 = Repro_first(points, comm_sz, my_rank);
+   j1 = Repro_first(points, comm_sz, my_rank+1);
+   values = malloc((j1 - j0 + 1)*sizeof(double));
+   buf = malloc((size_t)(j1 - j0 + 1)*CUMUL_RECORD);
+   MPI_Type_contiguous(CUMUL_RECORD, MPI_CHAR, &record_t);
+   MPI_Type_commit(&record_t);
+
+   local_beg = MPI_Wtime();
+   local_total = Cumul_prefix(integrand, a, h, k, j0, j1, values);
+   MPI_Exscan(&local_total, &offset, 1, MPI_DOUBLE, MPI_SUM,
+         MPI_COMM_WORLD);
+   /* MPI_Exscan leaves process 0's result undefined */
+   if (my_rank == 0) offset = 0.0;
+   Cumul_format(buf, a, h, k, j0, j1 - j0, values, offset);
+
+   error = MPI_File_open(MPI_COMM_WORLD, opts_p->cumul,
+         MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh)
+      != MPI_SUCCESS;
+   if (!error) {
+      MPI_File_set_size(fh, (MPI_Offset) points*CUMUL_RECORD);
+      error = MPI_File_write_at_all(fh, (MPI_Offset) j0*CUMUL_RECORD,
+            buf, j1 - j0, record_t, MPI_STATUS_IGNORE) != MPI_SUCCESS;
+      MPI_File_close(&fh);
+   }
+   MPI_Reduce(&local_total, &total, 1, MPI_DOUBLE, MPI_SUM, 0,
+         MPI_COMM_WORLD);
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+   MPI_Reduce(&error, &max_error, 1, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      if (max_error)
+         fprintf(stderr, "Error writing %s\n", opts_p->cumul);
+      else
+         Print_cumul_result(integrand, a, b, n, k, opts_p->cumul,
+               total + Cumul_tail(integrand, a, h, n, k));
+      printf("\nTime: %fs\n", global_time);
+   }
+
+   MPI_Type_free(&record_t);
+   free(values);
+   free(buf);
+   return error;
+}  /* Run_cumul */
+
+/*------------------------------------------------------------------
+ * Function:     Run_tab
+ * Purpose:      Integrate the (x, y) samples in the file fname.  Each
+ *               process maps its block of the samples, integrates it in
+ *               place, and adds the interval from its last sample to
+ *               the first sample of the next process.
+ * Input args:   fname, my_rank, comm_sz
+ * Return val:   0 on success, 1 if the file can't be read or has fewer
+ *               samples than there are processes
+ */
+int Run_tab(
+      const char* fname    /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   long long samples = 0, first, count;
+   tab_map_t map;
+   double next[2];
+   double local[2], total[2];   /* (integral, last x) */
+   int error, any_error;
+   MPI_Request requests[2];
+   double local_beg, local_time, global_time;
+
+   if (my_rank == 0) {
+      samples = Tab_samples(fname);
+      if (samples >= 0 && samples < comm_sz) {
+         fprintf(stderr, "%s has fewer samples than processes\n", fname);
+         samples = -1;
+      }
+   }
+   MPI_Bcast(&samples, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+   if (samples < 0) return 1;
+
+   local_beg = MPI_Wtime();
+   first = Repro_first(samples, comm_sz, my_rank);
+   count = Repro_first(samples, comm_sz, my_rank+1) - first;
+   error = Tab_map(fname, first, count, &map) != 0;
+   MPI_Allreduce(&error, &any_error, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+   if (any_error) {
+      Tab_unmap(&map);
+      return 1;
+   }
+
+   /* My first sample closes the last interval of the process before
+    * me, and the next process' first sample closes mine */
+   MPI_Irecv(next, 2, MPI_DOUBLE,
+         my_rank < comm_sz-1 ? my_rank+1 : MPI_PROC_NULL, 0,
+         MPI_COMM_WORLD, &requests[0]);
+   MPI_Isend(map.xy, 2, MPI_DOUBLE,
+         my_rank > 0 ? my_rank-1 : MPI_PROC_NULL, 0,
+         MPI_COMM_WORLD, &requests[1]);
+   local[0] = Tab_trap(map.xy, count);
+   MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+   if (my_rank < comm_sz-1)
+      local[0] += (next[0] - map.xy[2*count-2])
+            *(map.xy[2*count-1] + next[1])/2.0;
+
+   /* Only the last process adds in the end of the range */
+   local[1] = my_rank == comm_sz-1 ? map.xy[2*count-2] : 0.0;
+   MPI_Reduce(local, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      Print_tab_result(fname, samples, map.xy[0], total[1], total[0]);
+      printf("\nTime: %fs\n", global_time);
+   }
+   Tab_unmap(&map);
+   return 0;
+}  /* Run_tab */
+
+/*------------------------------------------------------------------
+ * Function:     Run_cached
+ * Purpose:      Trapezoidal rule (or -rule) using the cache in
+ *               opts_p->cache, computing only the blocks of the
+ *               lattice that aren't cached yet
+ * Input args:   a, b, n, opts_p, my_rank, comm_sz
+ * Return val:   0 on success, 1 on bad input or if the cache can't be
+ *               read or written
+ */
+int Run_cached(
+      double      a        /* in */,
+      double      b        /* in */,
+      int         n        /* in */,
+      const trap_opts_t* opts_p  /* in */,
+      int         my_rank  /* in */,
+      int         comm_sz  /* in */) {
+   cache_t cache;
+   cache_plan_t plan;
+   int error = 0, count, first, last, k;
+   double* sums;
+   double local_beg, local_time, global_time;
+
+   if (n < 1) return 1;
+   if (my_rank == 0) error = Cache_open(&cache, opts_p->cache) != 0;
+   MPI_Bcast(&error, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (error) return 1;
+
+   local_beg = MPI_Wtime();
+   /* Only process 0 looks the blocks up */
+   Cache_plan(&plan, my_rank == 0 ? &cache : NULL, opts_p->integrand,
+         opts_p->rule, a, b, n);
+   MPI_Bcast(&plan.hit, 1, MPI_INT, 0, MPI_COMM_WORLD);
+   if (!plan.hit) {
+      MPI_Bcast(&plan.missing_count, 1, MPI_INT, 0, MPI_COMM_WORLD);
+      count = plan.missing_count;
+      MPI_Bcast(plan.missing, count, MPI_INT, 0, MPI_COMM_WORLD);
+
+      first = Repro_first(count, comm_sz, my_rank);
+      last = Repro_first(count, comm_sz, my_rank+1);
+      Cache_fill(&plan, first, last);
+      sums = (double*) calloc(count > 0 ? count : 1, sizeof(double));
+      for (k = first; k < last; k++)
+         sums[k] = plan.values[plan.missing[k]];
+      MPI_Reduce(my_rank == 0 ? MPI_IN_PLACE : sums, sums, count,
+            MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+      if (my_rank == 0) {
+         for (k = 0; k < count; k++)
+            plan.values[plan.missing[k]] = sums[k];
+         Cache_finish(&plan, &cache);
+      }
+      free(sums);
+   }
+   local_time = MPI_Wtime() - local_beg;
+   MPI_Reduce(&local_time, &global_time, 1, MPI_DOUBLE, MPI_MAX, 0,
+         MPI_COMM_WORLD);
+
+   if (my_rank == 0) {
+      Print_cache_result(&plan);
+      printf("\nTime: %fs\n", global_time);
+      error = Cache_close(&cache) != 0;
+   }
+   Cache_plan_free(&plan);
+   return error;
+}  /* Run_cached */
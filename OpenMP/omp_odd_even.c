@@ -1,13 +1,19 @@
 /* File:    odd_even.c
  *
  * Purpose: Use odd-even transposition sort to sort a list of ints.
+ *          Each of the c threads sorts a block of the list with qsort,
+ *          then c phases of merge-split with the neighbouring block,
+ *          as in mpi_odd_even.c, sort the whole list.
  *
  * Compile: gcc -g -Wall -o odd_even odd_even.c
- * Run:     odd_even <n> <g|i> <c>
+ * Run:     odd_even <n> <g|i> <c> [o|s|r]
  *             n:   number of elements in list
  *            'g':  generate list using a random number generator
  *            'i':  user input list
  *            'c':  number of threads
+ *            'o':  block odd-even transposition sort (the default)
+ *            's':  sample sort, see ../Common/sample_sort.h
+ *            'r':  radix sort, see ../Common/radix_sort.h
  *
  * Input:   list (optional)
  * Output:  sorted list
@@ -16,29 +22,43 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <time.h>
 #include <omp.h>
+#include "../Common/sample_sort.h"
+#include "../Common/radix_sort.h"
+#include "../Common/repro.h"
 
 
 /* Keys in the random list in the range 0 <= key < RMAX */
 const int RMAX = 100000;
 
 void Usage(char* prog_name);
-void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int* thread_count);
+void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int* thread_count,
+      char* sort_p);
 void Generate_list(int a[], int n);
 void Print_list(int a[], int n, char* title);
 void Read_list(int a[], int n);
 void Omp_odd_even_sort(int a[], int n,int thread_count);
+void Omp_sample_sort(int a[], int n, int thread_count);
+void Omp_radix_sort(int a[], int n, int thread_count);
+int  Compare(const void* a_p, const void* b_p);
+void Merge_low(int my_keys[], int my_n, int partner_keys[], int partner_n,
+      int new_keys[]);
+void Merge_high(int my_keys[], int my_n, int partner_keys[], int partner_n,
+      int new_keys[]);
 
 /*-----------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
    int  n;
    char g_i;
+   char sort;
    int* a;
    int thread_count;
    double beg,end;
 
-   Get_args(argc, argv, &n, &g_i,&thread_count);
+   Get_args(argc, argv, &n, &g_i,&thread_count, &sort);
    a = (int*) malloc(n*sizeof(int));
    if (g_i == 'g') {
       Generate_list(a, n);
@@ -48,7 +68,12 @@ int main(int argc, char* argv[]) {
    }
 
    beg = omp_get_wtime();
-   Omp_odd_even_sort(a, n,thread_count);
+   if (sort == 's')
+      Omp_sample_sort(a, n, thread_count);
+   else if (sort == 'r')
+      Omp_radix_sort(a, n, thread_count);
+   else
+      Omp_odd_even_sort(a, n,thread_count);
    end = omp_get_wtime();
 
    Print_list(a, n, "After sort");
@@ -65,11 +90,14 @@ int main(int argc, char* argv[]) {
  * Purpose:   Summary of how to run program
  */
 void Usage(char* prog_name) {
-   fprintf(stderr, "usage:   %s <n> <g|i> <c>\n", prog_name);
+   fprintf(stderr, "usage:   %s <n> <g|i> <c> [o|s|r]\n", prog_name);
    fprintf(stderr, "   n:   number of elements in list\n");
    fprintf(stderr, "  'g':  generate list using a random number generator\n");
    fprintf(stderr, "  'i':  user input list\n");
    fprintf(stderr, "  'c':  number of count\n");
+   fprintf(stderr, "  'o':  block odd-even transposition sort (default)\n");
+   fprintf(stderr, "  's':  sample sort\n");
+   fprintf(stderr, "  'r':  radix sort\n");
 }  /* Usage */
 
 
@@ -77,20 +105,23 @@ void Usage(char* prog_name) {
  * Function:  Get_args
  * Purpose:   Get and check command line arguments
  * In args:   argc, argv
- * Out args:  n_p, g_i_p, thread_count
+ * Out args:  n_p, g_i_p, thread_count, sort_p
  */
-void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int* thread_count) {
-   if (argc != 4 ) {
+void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int* thread_count,
+      char* sort_p) {
+   if (argc != 4 && argc != 5) {
       Usage(argv[0]);
       exit(0);
    }
    *n_p = atoi(argv[1]);
    *g_i_p = argv[2][0];
    *thread_count = strtol(argv[3],NULL,10);
+   *sort_p = argc == 5 ? argv[4][0] : 'o';
 
    if (*n_p <= 0 
 	   || (*g_i_p != 'g' && *g_i_p != 'i')
-	   || *thread_count<1) {
+	   || *thread_count<1
+	   || (*sort_p != 'o' && *sort_p != 's' && *sort_p != 'r')) {
       Usage(argv[0]);
       exit(0);
    }
@@ -143,35 +174,306 @@ void Read_list(int a[], int n) {
 
 
 /*-----------------------------------------------------------------
- * Function:     Odd_even_sort
- * Purpose:      Sort list using odd-even transposition sort
- * In args:      n
+ * Function:  Compare
+ * Purpose:   Compare 2 ints, return -1, 0, or 1, respectively, when
+ *            the first int is less than, equal, or greater than
+ *            the second.  Used by qsort.
+ */
+int Compare(const void* a_p, const void* b_p) {
+   int a = *((int*)a_p);
+   int b = *((int*)b_p);
+
+   if (a < b)
+      return -1;
+   else if (a == b)
+      return 0;
+   else /* a > b */
+      return 1;
+}  /* Compare */
+
+
+/*-----------------------------------------------------------------
+ * Function:     Omp_odd_even_sort
+ * Purpose:      Sort list using block odd-even transposition sort:
+ *               each thread sorts its block with qsort, then in p
+ *               phases the p threads merge-split their blocks with a
+ *               neighbour's
+ * In args:      n, thread_count
  * In/out args:  a
+ * Notes:
+ * 1.  p phases only sort the list if the blocks are all the same
+ *     size, so each block has ceil(n/p) keys, and the last ones are
+ *     padded with INT_MAX.  The padding sorts to the end and isn't
+ *     copied back.
+ * 2.  p is the number of threads the runtime actually starts, which
+ *     may be fewer than thread_count.
+ * 3.  Each phase reads from one of two padded lists and writes every
+ *     block to the other, so the threads only need one barrier per
+ *     phase.
  */
 void Omp_odd_even_sort(
       int  a[]          /* in/out */, 
       int  n            /* in     */,
       int thread_count  /* in     */) {
-   int phase, i, temp;
+   int *list = NULL, *temp = NULL;
+   int p = 0, block_n = 0;
+
+   if (thread_count > n) thread_count = n;
 
 # pragma omp parallel num_threads(thread_count) \
-	default(none) shared(a, n) private(i,temp,phase)
-   for (phase = 0; phase < n; phase++) 
-      if (phase % 2 == 0) { /* Even phase */
-# pragma omp for
-         for (i = 1; i < n; i += 2) 
-            if (a[i-1] > a[i]) {
-               temp = a[i];
-               a[i] = a[i-1];
-               a[i-1] = temp;
-            }
-      } else { /* Odd phase */
-# pragma omp for
-         for (i = 1; i < n-1; i += 2)
-            if (a[i] > a[i+1]) {
-               temp = a[i];
-               a[i] = a[i+1];
-               a[i+1] = temp;
-            }
+      default(none) shared(a, n, list, temp, p, block_n)
+   {
+      int my_rank = omp_get_thread_num();
+      int my_first, my_keys, i;
+      int phase, partner;
+      int *src, *dst, *swap;
+
+#     pragma omp single
+      {
+         p = omp_get_num_threads();
+         block_n = (n + p - 1)/p;
+         list = (int*) malloc(p*block_n*sizeof(int));
+         temp = (int*) malloc(p*block_n*sizeof(int));
+      }
+
+      /* Keys of a in my block; the rest of it is padding */
+      my_first = my_rank*block_n;
+      my_keys = n - my_first < block_n ? n - my_first : block_n;
+      if (my_keys < 0) my_keys = 0;
+      if (my_keys > 0)   /* else a + my_first may be past the end */
+         memcpy(list + my_first, a + my_first, my_keys*sizeof(int));
+      for (i = my_keys; i < block_n; i++)
+         list[my_first + i] = INT_MAX;
+      qsort(list + my_first, block_n, sizeof(int), Compare);
+#     pragma omp barrier
+
+      src = list;
+      dst = temp;
+      for (phase = 0; phase < p; phase++) {
+         /* Even phases pair 0-1, 2-3, ...; odd phases 1-2, 3-4, ... */
+         if ((phase + my_rank) % 2 == 0)
+            partner = my_rank + 1;
+         else
+            partner = my_rank - 1;
+
+         if (partner < 0 || partner >= p)
+            memcpy(dst + my_first, src + my_first, block_n*sizeof(int));
+         else if (my_rank < partner)
+            Merge_low(src + my_first, block_n, src + partner*block_n,
+                  block_n, dst + my_first);
+         else
+            Merge_high(src + my_first, block_n, src + partner*block_n,
+                  block_n, dst + my_first);
+         swap = src; src = dst; dst = swap;
+#        pragma omp barrier
+      }
+
+      if (my_keys > 0)
+         memcpy(a + my_first, src + my_first, my_keys*sizeof(int));
+   }
+
+   free(list);
+   free(temp);
+}  /* Omp_odd_even_sort */
+
+
+/*-----------------------------------------------------------------
+ * Function:     Omp_sample_sort
+ * Purpose:      Sort list using sample sort: the p threads bucket their
+ *               blocks by p-1 splitters drawn from a sample of the
+ *               list, then thread j sorts bucket j
+ * In args:      n, thread_count
+ * In/out args:  a
+ * Note:         p is the number of threads the runtime actually starts,
+ *               which may be fewer than thread_count
+ */
+void Omp_sample_sort(
+      int  a[]          /* in/out */,
+      int  n            /* in     */,
+      int thread_count  /* in     */) {
+   int *temp, *samples = NULL, *splitters = NULL, *counts = NULL;
+   int p = 0;
+
+   if (thread_count > n) thread_count = n;
+   temp = (int*) malloc(n*sizeof(int));
+
+# pragma omp parallel num_threads(thread_count) default(none) \
+      shared(a, n, temp, samples, splitters, counts, p)
+   {
+      int my_rank = omp_get_thread_num();
+      int my_first, my_n;
+      int* my_counts;
+      int bucket_first, bucket_n;
+
+#     pragma omp single
+      {
+         p = omp_get_num_threads();
+         samples = (int*) malloc(p*SAMPLE_OVERSAMPLE*sizeof(int));
+         splitters = (int*) malloc(p*sizeof(int));
+         counts = (int*) malloc(p*p*sizeof(int));
+      }
+      my_first = Repro_first(n, p, my_rank);
+      my_n = Repro_first(n, p, my_rank+1) - my_first;
+      my_counts = (int*) malloc(p*sizeof(int));
+
+      Sample_pick(a + my_first, my_n, samples + my_rank*SAMPLE_OVERSAMPLE);
+#     pragma omp barrier
+#     pragma omp single
+      {
+         qsort(samples, p*SAMPLE_OVERSAMPLE, sizeof(int), Compare);
+         Sample_splitters(samples, p, splitters);
+      }
+
+      Sample_count(a + my_first, my_n, splitters, p, my_counts);
+      memcpy(counts + my_rank*p, my_counts, p*sizeof(int));
+#     pragma omp barrier
+
+      Sample_offsets(counts, p, my_rank, my_counts);
+      Sample_scatter(a + my_first, my_n, splitters, p, my_counts, temp);
+#     pragma omp barrier
+
+      bucket_first = Sample_bucket_first(counts, p, my_rank);
+      bucket_n = Sample_bucket_first(counts, p, my_rank+1) - bucket_first;
+      qsort(temp + bucket_first, bucket_n, sizeof(int), Compare);
+      memcpy(a + bucket_first, temp + bucket_first, bucket_n*sizeof(int));
+      free(my_counts);
+   }
+
+   free(temp);
+   free(samples);
+   free(splitters);
+   free(counts);
+}  /* Omp_sample_sort */
+
+
+/*-----------------------------------------------------------------
+ * Function:     Omp_radix_sort
+ * Purpose:      Sort list using a counting sort if the keys span a
+ *               small range, and an LSD radix sort if they don't
+ * In args:      n, thread_count
+ * In/out args:  a
+ * Note:         The list is split among the p threads the runtime
+ *               actually starts, which may be fewer than thread_count
+ */
+void Omp_radix_sort(
+      int  a[]          /* in/out */,
+      int  n            /* in     */,
+      int thread_count  /* in     */) {
+   int *temp, *mins = NULL, *maxs = NULL, *hist = NULL;
+   int p = 0;
+
+   if (thread_count > n) thread_count = n;
+   temp = (int*) malloc(n*sizeof(int));
+
+# pragma omp parallel num_threads(thread_count) default(none) \
+      shared(a, n, temp, mins, maxs, hist, p)
+   {
+      int my_rank = omp_get_thread_num();
+      int my_first, my_n;
+      int *src = a, *dst = temp, *swap, *my_offsets, *wc;
+      int pass;
+      radix_plan_t plan;
+
+#     pragma omp single
+      {
+         p = omp_get_num_threads();
+         mins = (int*) malloc(p*sizeof(int));
+         maxs = (int*) malloc(p*sizeof(int));
       }
-}  /* Odd_even_sort */
+      my_first = Repro_first(n, p, my_rank);
+      my_n = Repro_first(n, p, my_rank+1) - my_first;
+
+      Radix_min_max(a + my_first, my_n, &mins[my_rank], &maxs[my_rank]);
+#     pragma omp barrier
+      Radix_plan(mins, maxs, p, &plan);
+#     pragma omp single
+      hist = (int*) malloc(p*plan.buckets*sizeof(int));
+
+      if (plan.passes == 0) {
+         Radix_histogram(&plan, 0, a + my_first, my_n,
+               hist + my_rank*plan.buckets);
+#        pragma omp barrier
+         Radix_fill(&plan, hist, p, my_rank, a);
+      } else {
+         my_offsets = (int*) malloc(plan.buckets*sizeof(int));
+         wc = (int*) malloc(Radix_wc_size(&plan)*sizeof(int));
+         for (pass = 0; pass < plan.passes; pass++) {
+            Radix_histogram(&plan, pass, src + my_first, my_n,
+                  hist + my_rank*plan.buckets);
+#           pragma omp barrier
+            Radix_offsets(hist, p, plan.buckets, my_rank, my_offsets);
+            Radix_scatter(&plan, pass, src + my_first, my_n, my_offsets,
+                  wc, dst);
+            swap = src; src = dst; dst = swap;
+#           pragma omp barrier
+         }
+         if (src != a)
+            memcpy(a + my_first, src + my_first, my_n*sizeof(int));
+         free(my_offsets);
+         free(wc);
+      }
+   }
+
+   free(temp);
+   free(mins);
+   free(maxs);
+   free(hist);
+}  /* Omp_radix_sort */
+
+
+/*-----------------------------------------------------------------
+ * Function:    Merge_low
+ * Purpose:     Merge the smallest my_n elements of the sorted lists
+ *              my_keys and partner_keys into new_keys
+ * In args:     my_keys, my_n, partner_keys, partner_n
+ * Out args:    new_keys
+ */
+void Merge_low(
+      int  my_keys[]       /* in  */,
+      int  my_n            /* in  */,
+      int  partner_keys[]  /* in  */,
+      int  partner_n       /* in  */,
+      int  new_keys[]      /* out */) {
+   int m_i, p_i, n_i;
+
+   m_i = p_i = n_i = 0;
+   while (n_i < my_n) {
+      if (p_i >= partner_n || my_keys[m_i] <= partner_keys[p_i]) {
+         new_keys[n_i] = my_keys[m_i];
+         n_i++; m_i++;
+      } else {
+         new_keys[n_i] = partner_keys[p_i];
+         n_i++; p_i++;
+      }
+   }
+}  /* Merge_low */
+
+
+/*-----------------------------------------------------------------
+ * Function:    Merge_high
+ * Purpose:     Merge the largest my_n elements of the sorted lists
+ *              my_keys and partner_keys into new_keys
+ * In args:     my_keys, my_n, partner_keys, partner_n
+ * Out args:    new_keys
+ */
+void Merge_high(
+      int  my_keys[]       /* in  */,
+      int  my_n            /* in  */,
+      int  partner_keys[]  /* in  */,
+      int  partner_n       /* in  */,
+      int  new_keys[]      /* out */) {
+   int m_i, p_i, n_i;
+
+   m_i = my_n-1;
+   p_i = partner_n-1;
+   n_i = my_n-1;
+   while (n_i >= 0) {
+      if (p_i < 0 || my_keys[m_i] >= partner_keys[p_i]) {
+         new_keys[n_i] = my_keys[m_i];
+         n_i--; m_i--;
+      } else {
+         new_keys[n_i] = partner_keys[p_i];
+         n_i--; p_i--;
+      }
+   }
+}  /* Merge_high */
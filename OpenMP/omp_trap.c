@@ -1,9 +1,47 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<omp.h>
+#include "../Common/trap_opts.h"
+#include "../Common/adapt.h"
+#include "../Common/batch.h"
+#include "../Common/repro.h"
+#include "../Common/accum.h"
+#include "../Common/romberg.h"
+#include "../Common/cumul.h"
+#include "../Common/tabdata.h"
+#include "../Common/cache.h"
 
-void Trap(double a,double b,int n,double* global_result_p);
-double f(double x);
+/* A thread's deque of adaptive tasks and the lock guarding it */
+typedef struct {
+	adapt_deque_t deque;
+	omp_lock_t lock;
+} adapt_slot_t;
+
+void Usage(char* prog_name);
+void Trap(double a,double b,int n,const integrand_t* integrand,
+	accum_t* acc_p);
+void Rule_trap(double a,double b,int n,const quad_rule_t* rule,
+	const integrand_t* integrand,accum_t* acc_p);
+void Adapt_trap(double a,double b,int n,double tol,
+	const integrand_t* integrand,adapt_slot_t slots[],int* idle_p,
+	accum_t* acc_p,long* evals_p);
+void Adapt_push(void* slot,const adapt_task_t* task_p);
+int Run_batch(const char* fname,int thread_count);
+int Run_cubature(const cub_integrand_t* cub,int thread_count);
+int Run_qmc(const trap_opts_t* opts_p,int thread_count);
+int Run_cumul(double a,double b,int n,const trap_opts_t* opts_p,
+	int thread_count);
+int Run_tab(const char* fname,int thread_count);
+int Run_cached(double a,double b,int n,const trap_opts_t* opts_p,
+	int thread_count);
+double Repro_trap(double a,double b,int n,const integrand_t* integrand,
+	int thread_count);
+int Adapt_take(adapt_slot_t slots[],int my_rank,int thread_count,
+	adapt_task_t* task_p);
+double Parallel_sum(double x0,double step,int count,
+	const integrand_t* integrand,int thread_count,accum_t* acc_p);
+void Romberg_trap(romberg_t* r_p,const integrand_t* integrand,
+	int thread_count,accum_t* acc_p);
 
 int main(int argc, char *argv[])
 {
@@ -12,28 +50,144 @@ int main(int argc, char *argv[])
 	int n;
 	int thread_count;
 	double beg,end;
+	trap_opts_t opts;
+	int status;
+	adapt_slot_t* slots;
+	int i,idle = 0;
+	long evals = 0;
+	accum_t acc;
+	romberg_t romberg;
 
+	if(argc<2)
+		Usage(argv[0]);
 	thread_count = strtol(argv[1],NULL,10);
+	status = Get_trap_opts(argc,argv,2,&opts,1);
+	if(status>0)
+		return 0;
+	if(status<0)
+		return 1;	/* Get_trap_opts has said what was wrong */
+	if(thread_count<1)
+		Usage(argv[0]);
+	if(opts.batch!=NULL)
+		return Run_batch(opts.batch,thread_count);
+	if(opts.cub!=NULL)
+		return Run_cubature(opts.cub,thread_count);
+	if(opts.qmc!=NULL)
+		return Run_qmc(&opts,thread_count);
+	if(opts.tab!=NULL)
+		return Run_tab(opts.tab,thread_count);
+
 	printf("Enter a, b, and n\n");
 	scanf_s("%lf %lf %d",&a,&b,&n);
+	if(opts.cumul!=NULL)
+		return Run_cumul(a,b,n,&opts,thread_count);
+	if(opts.cache!=NULL&&opts.tol<=0.0&&opts.romberg<=0&&!opts.repro)
+		return Run_cached(a,b,n,&opts,thread_count);
+	Accum_init(&acc,thread_count);
 
-	beg=omp_get_wtime();
+	if(opts.tol>0.0)
+	{
+		if(n<1)
+			n = thread_count;
+		slots = (adapt_slot_t*)malloc(thread_count*sizeof(adapt_slot_t));
+		for(i=0;i<thread_count;i++)
+		{
+			Adapt_deque_init(&slots[i].deque);
+			omp_init_lock(&slots[i].lock);
+		}
+
+		beg=omp_get_wtime();
 # pragma omp parallel num_threads(thread_count)
-	Trap(a,b,n,&global_result);
-	end=omp_get_wtime();
+		Adapt_trap(a,b,n,opts.tol,opts.integrand,slots,&idle,
+			&acc,&evals);
+		global_result = Accum_combine(&acc);
+		end=omp_get_wtime();
+
+		for(i=0;i<thread_count;i++)
+		{
+			Adapt_deque_free(&slots[i].deque);
+			omp_destroy_lock(&slots[i].lock);
+		}
+		free(slots);
+		printf("With adaptive Simpson, tol = %e, %ld evaluations of f,\n",
+			opts.tol,evals);
+		printf("our estimate\n");
+	}
+	else if(opts.romberg>0)
+	{
+		Romberg_init(&romberg,a,b,n,opts.romberg);
+		beg=omp_get_wtime();
+		Romberg_trap(&romberg,opts.integrand,thread_count,&acc);
+		end=omp_get_wtime();
+
+		Romberg_print(&romberg,stdout);
+		global_result = romberg.R[romberg.level][romberg.level];
+		printf("\nWith Romberg extrapolation from n = %d to %d trapezoids,\n",
+			n,n<<romberg.level);
+		printf("our estimate\n");
+	}
+	else if(opts.repro)
+	{
+		beg=omp_get_wtime();
+		global_result = Repro_trap(a,b,n,opts.integrand,thread_count);
+		end=omp_get_wtime();
+
+		printf("With n = %d trapezoids (%s kernel, reproducible sum),\n",
+			n,trap_isa_names[opts.isa]);
+		printf("our estimate\n");
+	}
+	else if(opts.rule!=NULL)
+	{
+		beg=omp_get_wtime();
+# pragma omp parallel num_threads(thread_count)
+		Rule_trap(a,b,n,opts.rule,opts.integrand,&acc);
+		global_result = Accum_combine(&acc);
+		end=omp_get_wtime();
+
+		printf("With n = %d %s panels (%s kernel), our estimate\n",
+			n,opts.rule->name,trap_isa_names[opts.isa]);
+	}
+	else
+	{
+		beg=omp_get_wtime();
+# pragma omp parallel num_threads(thread_count)
+		Trap(a,b,n,opts.integrand,&acc);
+		global_result = Accum_combine(&acc);
+		end=omp_get_wtime();
 
-	printf("With n = %d trapezoids, our estimate\n",n);
-	printf("of the integral from %f to %f = %.14e\n",a,b,global_result);
+		printf("With n = %d trapezoids (%s kernel), our estimate\n",
+			n,trap_isa_names[opts.isa]);
+	}
+	printf("of the integral of %s from %f to %f = %.14e\n",
+		opts.integrand->formula,a,b,global_result);
 	printf("\nTime %f\n",end-beg);
 
+	Accum_free(&acc);
 	return 0;
 }
 
-void Trap(double a,double b,int n,double* global_result_p)
+/*------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Summary of how to run program
+ */
+void Usage(char* prog_name)
+{
+	fprintf(stderr,"usage: %s <thread_count> [options]\n",prog_name);
+	Trap_opts_usage();
+	exit(1);
+}
+
+/*------------------------------------------------------------------
+ * Function:    Trap
+ * Purpose:     Trapezoidal rule over this thread's block of the n
+ *              trapezoids, added into its slot of acc
+ */
+void Trap(double a,double b,int n,const integrand_t* integrand,
+	accum_t* acc_p)
 {
-	double h,x,my_result;
+	double h,my_result;
 	double local_a,local_b;
-	int i,local_n;
+	int local_n;
 	int my_rank = omp_get_thread_num();
 	int thread_count = omp_get_num_threads();
 
@@ -41,22 +195,471 @@ void Trap(double a,double b,int n,double* global_result_p)
 	local_n = n/thread_count;
 	local_a = a+my_rank*local_n*h;
 	local_b = local_a + local_n*h;
-	my_result = (f(local_a)+f(local_b))/2.0;
+	my_result = (integrand->f(local_a)+integrand->f(local_b))/2.0;
+	my_result += integrand->sum(local_a,h,1,local_n-1);
+	my_result = my_result*h;
+
+	Accum_add(acc_p,my_rank,my_result);
+}
 
-	for(i = 1;i<=local_n-1;i++)
+/*------------------------------------------------------------------
+ * Function:    Rule_trap
+ * Purpose:     Apply rule to this thread's block of the n panels,
+ *              added into its slot of acc
+ */
+void Rule_trap(double a,double b,int n,const quad_rule_t* rule,
+	const integrand_t* integrand,accum_t* acc_p)
+{
+	int my_rank = omp_get_thread_num();
+	int thread_count = omp_get_num_threads();
+
+	Accum_add(acc_p,my_rank,Rule_sum(rule,integrand,a,(b-a)/n,
+		Repro_first(n,thread_count,my_rank),
+		Repro_first(n,thread_count,my_rank+1)));
+}
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_trap
+ * Purpose:     Adaptive Simpson's rule with work stealing.  Each
+ *              thread starts from every thread_count-th of the n
+ *              panels, refines depth first, and when its own deque
+ *              runs dry steals the oldest task from another thread.
+ *              The threads stop when all of them are idle.
+ * In args:     a, b, n, tol, integrand
+ * In/out args: slots:  one deque per thread
+ *              idle_p: number of idle threads, initially 0
+ *              acc_p:  each thread adds its estimate to its slot
+ *              evals_p:  sum over the threads
+ */
+void Adapt_trap(double a,double b,int n,double tol,
+	const integrand_t* integrand,adapt_slot_t slots[],int* idle_p,
+	accum_t* acc_p,long* evals_p)
+{
+	int my_rank = omp_get_thread_num();
+	int thread_count = omp_get_num_threads();
+	adapt_task_t task;
+	double my_result = 0.0;
+	long my_evals = 0;
+	int i,size,idle,done = 0;
+
+	for(i = my_rank;i<n;i+=thread_count)
 	{
-		x = local_a+i*h;
-		my_result+=f(x);
+		Adapt_first_task(integrand,a,b,n,i,tol,&task,&my_evals);
+		Adapt_push(&slots[my_rank],&task);
 	}
-	my_result = my_result*h;
 
+	while(!done)
+	{
+		if(Adapt_take(slots,my_rank,thread_count,&task))
+		{
+			my_result += Adapt_run(integrand,task,Adapt_push,
+				&slots[my_rank],&my_evals);
+			continue;
+		}
+
+		/* Idle threads hold no tasks, so once every thread is idle
+		 * there is nothing left anywhere */
+# pragma omp critical(adapt_idle)
+		idle = ++(*idle_p);
+		while(idle<thread_count)
+		{
+			for(i = 0;i<thread_count;i++)
+			{
+				omp_set_lock(&slots[i].lock);
+				size = Adapt_deque_size(&slots[i].deque);
+				omp_unset_lock(&slots[i].lock);
+				if(size>0)
+					break;
+			}
+			if(i<thread_count)
+			{
+# pragma omp critical(adapt_idle)
+				(*idle_p)--;
+				break;
+			}
+# pragma omp critical(adapt_idle)
+			idle = *idle_p;
+		}
+		done = idle==thread_count;
+	}
+
+	Accum_add(acc_p,my_rank,my_result);
 # pragma omp critical
-	*global_result_p += my_result;
+	*evals_p += my_evals;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_push
+ * Purpose:     Put a task on the bottom of a thread's deque
+ */
+void Adapt_push(void* slot,const adapt_task_t* task_p)
+{
+	adapt_slot_t* slot_p = (adapt_slot_t*)slot;
+
+	omp_set_lock(&slot_p->lock);
+	Adapt_deque_push(&slot_p->deque,task_p);
+	omp_unset_lock(&slot_p->lock);
+}
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_take
+ * Purpose:     Pop the newest task from my deque, or failing that
+ *              steal the oldest task from the next thread that has one
+ * Return val:  1 if a task was found
+ */
+int Adapt_take(adapt_slot_t slots[],int my_rank,int thread_count,
+	adapt_task_t* task_p)
+{
+	int i,victim,found;
+
+	for(i = 0;i<thread_count;i++)
+	{
+		victim = (my_rank+i)%thread_count;
+		omp_set_lock(&slots[victim].lock);
+		if(i==0)
+			found = Adapt_deque_pop(&slots[victim].deque,task_p);
+		else
+			found = Adapt_deque_steal(&slots[victim].deque,task_p);
+		omp_unset_lock(&slots[victim].lock);
+		if(found)
+			return 1;
+	}
+	return 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Run_batch
+ * Purpose:     Compute every job in a batch file with one team of
+ *              threads, each job by a single thread, and print the
+ *              results in file order
+ * Return val:  0 on success, 1 if the file can't be read
+ */
+int Run_batch(const char* fname,int thread_count)
+{
+	batch_job_t* jobs;
+	double* results;
+	int i,count;
+	double beg,end;
+
+	if(Read_batch(fname,&jobs,&count)!=0)
+		return 1;
+	results = (double*)malloc(count*sizeof(double));
+
+	beg=omp_get_wtime();
+# pragma omp parallel for num_threads(thread_count) schedule(dynamic)
+	for(i = 0;i<count;i++)
+		results[i] = Batch_trap(&jobs[i]);
+	end=omp_get_wtime();
+
+	Print_batch(jobs,results,count);
+	printf("\n%d jobs, time %f\n",count,end-beg);
+
+	free(jobs);
+	free(results);
+	return 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Repro_trap
+ * Purpose:     Trapezoidal rule whose result doesn't depend on
+ *              thread_count: the threads share out the leaves of
+ *              repro.h and the leaves are added by a fixed tree
+ * Return val:  Estimate of the integral
+ */
+double Repro_trap(double a,double b,int n,const integrand_t* integrand,
+	int thread_count)
+{
+	int j,leaf_count = Repro_leaf_count(n);
+	double h = (b-a)/n;
+	double* leaves = (double*)malloc(leaf_count*sizeof(double));
+	double result;
+
+# pragma omp parallel for num_threads(thread_count) schedule(static)
+	for(j = 0;j<leaf_count;j++)
+		leaves[j] = Repro_leaf(integrand,a,h,n,leaf_count,j);
+
+	result = Pairwise_sum(leaves,leaf_count);
+	free(leaves);
+	return result;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Parallel_sum
+ * Purpose:     Sum of f(x0 + i*step), 0 <= i < count, with the i's
+ *              split into contiguous blocks among the threads
+ */
+double Parallel_sum(double x0,double step,int count,
+	const integrand_t* integrand,int thread_count,accum_t* acc_p)
+{
+	Accum_reset(acc_p);
+# pragma omp parallel num_threads(thread_count)
+	{
+		int my_rank = omp_get_thread_num();
+		int threads = omp_get_num_threads();
+		int first = Repro_first(count,threads,my_rank);
+		int last = Repro_first(count,threads,my_rank+1);
+
+		Accum_add(acc_p,my_rank,integrand->sum(x0,step,first,last-1));
+	}
+	return Accum_combine(acc_p);
+}
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_trap
+ * Purpose:     Fill in a Romberg table.  Each level evaluates only
+ *              the midpoints of the previous level's trapezoids.
+ * In/out args: r_p:  initialized by Romberg_init
+ */
+void Romberg_trap(romberg_t* r_p,const integrand_t* integrand,
+	int thread_count,accum_t* acc_p)
+{
+	double h = (r_p->b-r_p->a)/r_p->n;
+	double x0,step;
+	int count;
+
+	Romberg_add(r_p,(integrand->f(r_p->a)+integrand->f(r_p->b))/2.0
+		+ Parallel_sum(r_p->a+h,h,r_p->n-1,integrand,thread_count,acc_p));
+	while(Romberg_next(r_p,&x0,&step,&count))
+		Romberg_add(r_p,Parallel_sum(x0,step,count,integrand,
+			thread_count,acc_p));
+}
+
+/*------------------------------------------------------------------
+ * Function:    Run_cubature
+ * Purpose:     Read a box and n, and integrate a 2D or 3D integrand
+ *              over it.  The threads take tiles of the grid
+ *              dynamically and add their tile sums to their own slot.
+ * Return val:  0 on success, 1 on bad input
+ */
+int Run_cubature(const cub_integrand_t* cub,int thread_count)
+{
+	double a[3],b[3];
+	int n[3];
+	cub_grid_t grid;
+	accum_t acc;
+	long tile,tile_count;
+	double result,beg,end;
+
+	if(Read_cub_box(cub->dims,a,b,n)!=0)
+		return 1;
+	Cub_grid_init(&grid,cub->dims,a,b,n);
+	tile_count = Cub_tile_count(&grid);
+	Accum_init(&acc,thread_count);
+
+	beg=omp_get_wtime();
+# pragma omp parallel for num_threads(thread_count) schedule(dynamic)
+	for(tile = 0;tile<tile_count;tile++)
+		Accum_add(&acc,omp_get_thread_num(),Cub_tile(cub,&grid,tile));
+	result = Accum_combine(&acc)*Cub_cell_volume(&grid);
+	end=omp_get_wtime();
+
+	Print_cub_result(cub,&grid,result);
+	printf("\nTime %f\n",end-beg);
+
+	Accum_free(&acc);
+	return 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Run_qmc
+ * Purpose:     Read d, a, b and the number of samples, and integrate
+ *              a d-dimensional integrand over [a, b]^d.  Each thread
+ *              makes and evaluates its own block of sample indices.
+ * Return val:  0 on success, 1 on bad input
+ */
+int Run_qmc(const trap_opts_t* opts_p,int thread_count)
+{
+	qmc_gen_t gen;
+	int dims;
+	double a,b;
+	long long samples;
+	accum_t acc,acc_sq;
+	double sum,sumsq,beg,end;
+
+	if(Read_qmc_input(opts_p->seq,&dims,&a,&b,&samples)!=0)
+		return 1;
+	Qmc_init(&gen,opts_p->seq,dims,a,b,opts_p->seed);
+	Accum_init(&acc,thread_count);
+	Accum_init(&acc_sq,thread_count);
+
+	beg=omp_get_wtime();
+# pragma omp parallel num_threads(thread_count)
+	{
+		int my_rank = omp_get_thread_num();
+		int threads = omp_get_num_threads();
+		double my_sum = 0.0,my_sumsq = 0.0;
+
+		Qmc_sum(opts_p->qmc,&gen,Repro_first(samples,threads,my_rank),
+			Repro_first(samples,threads,my_rank+1),&my_sum,&my_sumsq);
+		Accum_add(&acc,my_rank,my_sum);
+		Accum_add(&acc_sq,my_rank,my_sumsq);
+	}
+	sum = Accum_combine(&acc);
+	sumsq = Accum_combine(&acc_sq);
+	end=omp_get_wtime();
+
+	Print_qmc_result(opts_p->qmc,&gen,samples,sum,sumsq);
+	printf("\nTime %f\n",end-beg);
+
+	Accum_free(&acc);
+	Accum_free(&acc_sq);
+	return 0;
 }
 
-double f(double x) {
-   double return_val;
+/*------------------------------------------------------------------
+ * Function:    Run_cumul
+ * Purpose:     Write the cumulative integral at every k-th grid point
+ *              to a file, by a two pass scan over the threads (see
+ *              cumul.h).  Each thread formats its own records into
+ *              one buffer, which is then written in one piece.
+ * Return val:  0 on success, 1 on bad input or if the file can't be
+ *              written
+ */
+int Run_cumul(double a,double b,int n,const trap_opts_t* opts_p,
+	int thread_count)
+{
+	const integrand_t* integrand = opts_p->integrand;
+	int k = opts_p->every;
+	double h = (b-a)/n;
+	int points,i;
+	double* values;
+	double* totals;
+	char* buf;
+	double total,beg,end;
+	FILE* fp;
 
-   return_val = x*x;
-   return return_val;
-}
\ No newline at end of file
+	if(n<1)
+		return 1;
+	fp = fopen(opts_p->cumul,"wb");
+	if(fp==NULL)
+	{
+		fprintf(stderr,"Can't open %s\n",opts_p->cumul);
+		return 1;
+	}
+	points = Cumul_point_count(n,k);
+	values = (double*)malloc(points*sizeof(double));
+	/* The team may be smaller than thread_count; unused slots stay 0 */
+	totals = (double*)calloc(thread_count,sizeof(double));
+	buf = (char*)malloc((size_t)points*CUMUL_RECORD);
+
+	beg=omp_get_wtime();
+# pragma omp parallel num_threads(thread_count)
+	{
+		int my_rank = omp_get_thread_num();
+		int threads = omp_get_num_threads();
+		int j0 = Repro_first(points,threads,my_rank);
+		int j1 = Repro_first(points,threads,my_rank+1);
+		double offset = 0.0;
+		int t;
+
+		totals[my_rank] = Cumul_prefix(integrand,a,h,k,j0,j1,values+j0);
+# pragma omp barrier
+		for(t = 0;t<my_rank;t++)
+			offset += totals[t];
+		Cumul_format(buf+(size_t)j0*CUMUL_RECORD,a,h,k,j0,j1-j0,
+			values+j0,offset);
+	}
+	total = Cumul_tail(integrand,a,h,n,k);
+	for(i = 0;i<thread_count;i++)
+		total += totals[i];
+	i = fwrite(buf,CUMUL_RECORD,points,fp)!=(size_t)points;
+	i |= fclose(fp)!=0;
+	end=omp_get_wtime();
+
+	if(i)
+		fprintf(stderr,"Error writing %s\n",opts_p->cumul);
+	else
+		Print_cumul_result(integrand,a,b,n,k,opts_p->cumul,total);
+	printf("\nTime %f\n",end-beg);
+
+	free(values);
+	free(totals);
+	free(buf);
+	return i;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Run_tab
+ * Purpose:     Integrate the (x, y) samples in a file.  The file is
+ *              mapped once, and each thread integrates its block of
+ *              the intervals where it lies in the mapping.
+ * Return val:  0 on success, 1 if the file can't be read
+ */
+int Run_tab(const char* fname,int thread_count)
+{
+	long long samples;
+	tab_map_t map;
+	accum_t acc;
+	double total,beg,end;
+
+	samples = Tab_samples(fname);
+	if(samples<0)
+		return 1;
+	beg=omp_get_wtime();
+	if(Tab_map(fname,0,samples,&map)!=0)
+		return 1;
+	Accum_init(&acc,thread_count);
+# pragma omp parallel num_threads(thread_count)
+	{
+		int my_rank = omp_get_thread_num();
+		int threads = omp_get_num_threads();
+		long long i0 = Repro_first(samples-1,threads,my_rank);
+		long long i1 = Repro_first(samples-1,threads,my_rank+1);
+
+		/* Intervals i0, ..., i1-1 need samples i0, ..., i1 */
+		Accum_add(&acc,my_rank,Tab_trap(map.xy+2*i0,i1-i0+1));
+	}
+	total = Accum_combine(&acc);
+	end=omp_get_wtime();
+
+	Print_tab_result(fname,samples,map.xy[0],map.xy[2*samples-2],total);
+	printf("\nTime %f\n",end-beg);
+
+	Tab_unmap(&map);
+	Accum_free(&acc);
+	return 0;
+}
+
+/*------------------------------------------------------------------
+ * Function:    Run_cached
+ * Purpose:     Trapezoidal rule (or -rule) using the cache in
+ *              opts_p->cache: the threads compute only the blocks of
+ *              the lattice that aren't cached yet (see cache.h)
+ * Return val:  0 on success, 1 on bad input or if the cache can't be
+ *              read or written
+ */
+int Run_cached(double a,double b,int n,const trap_opts_t* opts_p,
+	int thread_count)
+{
+	cache_t cache;
+	cache_plan_t plan;
+	double beg,end;
+
+	if(n<1)
+		return 1;
+	if(Cache_open(&cache,opts_p->cache)!=0)
+		return 1;
+
+	beg=omp_get_wtime();
+	Cache_plan(&plan,&cache,opts_p->integrand,opts_p->rule,a,b,n);
+	if(!plan.hit)
+	{
+# pragma omp parallel num_threads(thread_count)
+		{
+			int my_rank = omp_get_thread_num();
+			int threads = omp_get_num_threads();
+
+			Cache_fill(&plan,
+				Repro_first(plan.missing_count,threads,my_rank),
+				Repro_first(plan.missing_count,threads,my_rank+1));
+		}
+		Cache_finish(&plan,&cache);
+	}
+	end=omp_get_wtime();
+
+	Print_cache_result(&plan);
+	printf("\nTime %f\n",end-beg);
+
+	Cache_plan_free(&plan);
+	return Cache_close(&cache)!=0;
+}
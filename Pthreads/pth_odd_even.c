@@ -1,13 +1,19 @@
 /* File:    odd_even.c
  *
  * Purpose: Use odd-even transposition sort to sort a list of ints.
+ *          Each of the c threads sorts a block of the list with qsort,
+ *          then c phases of merge-split with the neighbouring block,
+ *          as in mpi_odd_even.c, sort the whole list.
  *
  * Compile: gcc -g -Wall -o odd_even odd_even.c
- * Run:     odd_even <n> <g|i> <c>
+ * Run:     odd_even <n> <g|i> <c> [o|s|r]
  *             n:   number of elements in list
  *            'g':  generate list using a random number generator
  *            'i':  user input list
  *            'c':  the number of threads
+ *            'o':  block odd-even transposition sort (the default)
+ *            's':  sample sort, see ../Common/sample_sort.h
+ *            'r':  radix sort, see ../Common/radix_sort.h
  *
  * Input:   list (optional)
  * Output:  sorted list
@@ -17,9 +23,14 @@
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
 #include <pthread.h>
 #include <semaphore.h>
 #include <Windows.h>
+#include "../Common/sample_sort.h"
+#include "../Common/radix_sort.h"
+#include "../Common/repro.h"
 
 #pragma comment(lib,"pthreadVC2.lib")
 
@@ -28,6 +39,15 @@ const int RMAX = 1000;
 
 int thread_count;
 int* a;
+int* list;    /* a in blocks of block_n, padded with INT_MAX */
+int  block_n;
+int* temp;    /* scratch list for the merge-split phases or buckets */
+int* samples;
+int* splitters;
+int* counts;  /* row i: thread i's key count in each bucket */
+int* mins;
+int* maxs;
+int* hist;    /* row i: thread i's radix histogram */
 int n;
 int phase;
 int counter;
@@ -35,20 +55,30 @@ pthread_mutex_t mutex;
 pthread_cond_t cond_var;
 
 void Usage(char* prog_name);
-void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int*thread_count);
+void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int*thread_count,
+      char* sort_p);
 void Generate_list(int a[], int n);
 void Print_list(int a[], int n, char* title);
 void Read_list(int a[], int n);
 void* Odd_even_sort(void* rank);
+void* Sample_sort(void* rank);
+void* Radix_sort(void* rank);
+int  Compare(const void* a_p, const void* b_p);
+void Barrier(void);
+void Merge_low(int my_keys[], int my_n, int partner_keys[], int partner_n,
+      int new_keys[]);
+void Merge_high(int my_keys[], int my_n, int partner_keys[], int partner_n,
+      int new_keys[]);
 
 /*-----------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
    char g_i;
+   char sort;
    int i;
    pthread_t* thread_handles = NULL;
    double beg,end;
 
-   Get_args(argc, argv, &n, &g_i,&thread_count);
+   Get_args(argc, argv, &n, &g_i,&thread_count, &sort);
    a = (int*) malloc(n*sizeof(int));
    if (g_i == 'g') {
       Generate_list(a, n);
@@ -57,7 +87,18 @@ int main(int argc, char* argv[]) {
       Read_list(a, n);
    }
 
-  
+   /* Every thread gets at least one key */
+   if (thread_count > n) thread_count = n;
+   block_n = (n + thread_count - 1)/thread_count;
+   list = (int*) malloc(thread_count*block_n*sizeof(int));
+   temp = (int*) malloc(thread_count*block_n*sizeof(int));
+   samples = (int*) malloc(thread_count*SAMPLE_OVERSAMPLE*sizeof(int));
+   splitters = (int*) malloc(thread_count*sizeof(int));
+   counts = (int*) malloc(thread_count*thread_count*sizeof(int));
+   mins = (int*) malloc(thread_count*sizeof(int));
+   maxs = (int*) malloc(thread_count*sizeof(int));
+   hist = NULL;
+
    phase = 0;
    counter=0;
    pthread_cond_init(&cond_var,NULL);
@@ -66,7 +107,9 @@ int main(int argc, char* argv[]) {
 
    beg = GetTickCount();
    for(i=0;i<thread_count;i++)
-	   pthread_create(&thread_handles[i],NULL,Odd_even_sort,(void*)i);
+	   pthread_create(&thread_handles[i],NULL,
+            sort == 's' ? Sample_sort
+            : sort == 'r' ? Radix_sort : Odd_even_sort,(void*)i);
 
    for(i=0;i<thread_count;i++)
 	   pthread_join(thread_handles[i],NULL);
@@ -77,6 +120,15 @@ int main(int argc, char* argv[]) {
    Print_list(a, n, "After sort");
    printf("\nTime: %fs\n",(end-beg)/1000);
    
+   free(list);
+   free(temp);
+   free(samples);
+   free(splitters);
+   free(counts);
+   free(mins);
+   free(maxs);
+   free(hist);
+   free(thread_handles);
    free(a);
    return 0;
 }  /* main */
@@ -87,11 +139,14 @@ int main(int argc, char* argv[]) {
  * Purpose:   Summary of how to run program
  */
 void Usage(char* prog_name) {
-   fprintf(stderr, "usage:   %s <n> <g|i> <c>\n", prog_name);
+   fprintf(stderr, "usage:   %s <n> <g|i> <c> [o|s|r]\n", prog_name);
    fprintf(stderr, "   n:   number of elements in list\n");
    fprintf(stderr, "  'g':  generate list using a random number generator\n");
    fprintf(stderr, "  'i':  user input list\n");
    fprintf(stderr, "  'c':  number of threads\n");
+   fprintf(stderr, "  'o':  block odd-even transposition sort (default)\n");
+   fprintf(stderr, "  's':  sample sort\n");
+   fprintf(stderr, "  'r':  radix sort\n");
 }  /* Usage */
 
 
@@ -99,18 +154,21 @@ void Usage(char* prog_name) {
  * Function:  Get_args
  * Purpose:   Get and check command line arguments
  * In args:   argc, argv
- * Out args:  n_p, g_i_p, thread_count
+ * Out args:  n_p, g_i_p, thread_count, sort_p
  */
-void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int*thread_count) {
-   if (argc != 4 ) {
+void Get_args(int argc, char* argv[], int* n_p, char* g_i_p,int*thread_count,
+      char* sort_p) {
+   if (argc != 4 && argc != 5) {
       Usage(argv[0]);
       exit(0);
    }
    *n_p = atoi(argv[1]);
    *g_i_p = argv[2][0];
    *thread_count = strtol(argv[3],NULL,10);
+   *sort_p = argc == 5 ? argv[4][0] : 'o';
 
-   if (*n_p <= 0 || (*g_i_p != 'g' && *g_i_p != 'i') ) {
+   if (*n_p <= 0 || (*g_i_p != 'g' && *g_i_p != 'i') || *thread_count < 1
+         || (*sort_p != 'o' && *sort_p != 's' && *sort_p != 'r')) {
       Usage(argv[0]);
       exit(0);
    }
@@ -162,66 +220,258 @@ void Read_list(int a[], int n) {
 }  /* Read_list */
 
 
+/*-----------------------------------------------------------------
+ * Function:  Compare
+ * Purpose:   Compare 2 ints, return -1, 0, or 1, respectively, when
+ *            the first int is less than, equal, or greater than
+ *            the second.  Used by qsort.
+ */
+int Compare(const void* a_p, const void* b_p) {
+   int a = *((int*)a_p);
+   int b = *((int*)b_p);
+
+   if (a < b)
+      return -1;
+   else if (a == b)
+      return 0;
+   else /* a > b */
+      return 1;
+}  /* Compare */
+
+
+/*-----------------------------------------------------------------
+ * Function:  Barrier
+ * Purpose:   Wait until all the threads have called Barrier.  The
+ *            last thread to arrive starts the next phase.
+ */
+void Barrier(void) {
+   int my_phase;
+
+   pthread_mutex_lock(&mutex);
+   my_phase = phase;
+   counter++;
+   if (counter == thread_count) {
+      counter = 0;
+      phase++;
+      pthread_cond_broadcast(&cond_var);
+   } else {
+      while (phase == my_phase)
+         pthread_cond_wait(&cond_var, &mutex);
+   }
+   pthread_mutex_unlock(&mutex);
+}  /* Barrier */
+
+
 /*-----------------------------------------------------------------
  * Function:     Odd_even_sort
- * Purpose:      Sort list using odd-even transposition sort
- * In args:      n
- * In/out args:  a
+ * Purpose:      Sort list using block odd-even transposition sort:
+ *               each thread sorts its block with qsort, then in
+ *               thread_count phases the threads merge-split their
+ *               blocks with a neighbour's
+ * In arg:       rank
+ * Globals in:   n, thread_count, block_n
+ * Global in/out: a
+ * Scratch:      list, temp
+ * Notes:
+ * 1.  thread_count phases only sort the list if the blocks are all the
+ *     same size, so the keys are copied into list in blocks of
+ *     block_n = ceil(n/thread_count), and the last ones are padded
+ *     with INT_MAX.  The padding sorts to the end and isn't copied
+ *     back.
+ * 2.  Each phase reads from one of list and temp and writes every
+ *     block to the other, so the threads only need one barrier per
+ *     phase.
  */
 void* Odd_even_sort(void* rank) {
-	long my_rank = (long)rank;
-	int local_a = my_rank*n/thread_count;
-	int local_b = local_a+n/thread_count;
-	int i, temp;
-	
-	//ÿһ̵߳iʼΪ
-	if(local_a%2==0)
-		   local_a++;
-
-   while(phase<n)
-   {
-	   i = local_a;
-
-	   //ֹʱһ̱߳鱻©Խ
-	   if(my_rank==thread_count-1)
-		   if(phase%2==0)
-			   local_b=n;
-		   else
-			   local_b=n-1;
-      if (phase % 2 == 0) { /* Even phase */
-		  //ĩΪʱҪ
-		  if(local_b<n&&local_b%2)
-			  local_b++;
-         for (; i < local_b; i += 2) 
-            if (a[i-1] > a[i]) {
-               temp = a[i];
-               a[i] = a[i-1];
-               a[i-1] = temp;
-            }
-      } else { /* Odd phase */
-		  if(local_b<n-1&&local_b%2)
-			  local_b++;
-         for (; i < local_b; i += 2)
-            if (a[i] > a[i+1]) {
-               temp = a[i];
-               a[i] = a[i+1];
-               a[i+1] = temp;
-            }
-      }
+   long my_rank = (long) rank;
+   int my_first = my_rank*block_n;
+   int my_keys = n - my_first < block_n ? n - my_first : block_n;
+   int my_phase, partner, i;
+   int *src = list, *dst = temp, *swap;
+
+   /* Keys of a in my block; the rest of it is padding */
+   if (my_keys < 0) my_keys = 0;
+   if (my_keys > 0)   /* else a + my_first may be past the end */
+      memcpy(list + my_first, a + my_first, my_keys*sizeof(int));
+   for (i = my_keys; i < block_n; i++)
+      list[my_first + i] = INT_MAX;
+   qsort(list + my_first, block_n, sizeof(int), Compare);
+   Barrier();
 
-	  //·ϣ߳Ӧͬʱʼż
-	  /* Barrier */
-	  pthread_mutex_lock(&mutex);
-	  counter++;
-	  if(counter == thread_count){
-		  counter = 0;
-		  phase++;
-		  pthread_cond_broadcast(&cond_var);
-	  }else{
-		  while(pthread_cond_wait(&cond_var,&mutex)!=0);
-	  }
-	  pthread_mutex_unlock(&mutex);
+   for (my_phase = 0; my_phase < thread_count; my_phase++) {
+      /* Even phases pair 0-1, 2-3, ...; odd phases 1-2, 3-4, ... */
+      if ((my_phase + my_rank) % 2 == 0)
+         partner = my_rank + 1;
+      else
+         partner = my_rank - 1;
+
+      if (partner < 0 || partner >= thread_count)
+         memcpy(dst + my_first, src + my_first, block_n*sizeof(int));
+      else if (my_rank < partner)
+         Merge_low(src + my_first, block_n, src + partner*block_n,
+               block_n, dst + my_first);
+      else
+         Merge_high(src + my_first, block_n, src + partner*block_n,
+               block_n, dst + my_first);
+      swap = src; src = dst; dst = swap;
+      Barrier();
    }
-	  return NULL;
+
+   if (my_keys > 0)
+      memcpy(a + my_first, src + my_first, my_keys*sizeof(int));
+   return NULL;
 }  /* Odd_even_sort */
 
+
+/*-----------------------------------------------------------------
+ * Function:     Sample_sort
+ * Purpose:      Sort list using sample sort: the threads bucket their
+ *               blocks by thread_count-1 splitters drawn from a sample
+ *               of the list, then thread j sorts bucket j
+ * In arg:       rank
+ * Globals in:   n, thread_count
+ * Global in/out: a
+ * Scratch:      temp, samples, splitters, counts
+ */
+void* Sample_sort(void* rank) {
+   long my_rank = (long) rank;
+   int my_first = Repro_first(n, thread_count, my_rank);
+   int my_n = Repro_first(n, thread_count, my_rank+1) - my_first;
+   int* my_counts = (int*) malloc(thread_count*sizeof(int));
+   int bucket_first, bucket_n;
+
+   Sample_pick(a + my_first, my_n, samples + my_rank*SAMPLE_OVERSAMPLE);
+   Barrier();
+   if (my_rank == 0) {
+      qsort(samples, thread_count*SAMPLE_OVERSAMPLE, sizeof(int), Compare);
+      Sample_splitters(samples, thread_count, splitters);
+   }
+   Barrier();
+
+   Sample_count(a + my_first, my_n, splitters, thread_count, my_counts);
+   memcpy(counts + my_rank*thread_count, my_counts,
+         thread_count*sizeof(int));
+   Barrier();
+
+   Sample_offsets(counts, thread_count, my_rank, my_counts);
+   Sample_scatter(a + my_first, my_n, splitters, thread_count, my_counts,
+         temp);
+   Barrier();
+
+   bucket_first = Sample_bucket_first(counts, thread_count, my_rank);
+   bucket_n = Sample_bucket_first(counts, thread_count, my_rank+1)
+      - bucket_first;
+   qsort(temp + bucket_first, bucket_n, sizeof(int), Compare);
+   memcpy(a + bucket_first, temp + bucket_first, bucket_n*sizeof(int));
+   free(my_counts);
+   return NULL;
+}  /* Sample_sort */
+
+
+/*-----------------------------------------------------------------
+ * Function:     Radix_sort
+ * Purpose:      Sort list using a counting sort if the keys span a
+ *               small range, and an LSD radix sort if they don't
+ * In arg:       rank
+ * Globals in:   n, thread_count
+ * Global in/out: a
+ * Scratch:      temp, mins, maxs, hist
+ */
+void* Radix_sort(void* rank) {
+   long my_rank = (long) rank;
+   int my_first = Repro_first(n, thread_count, my_rank);
+   int my_n = Repro_first(n, thread_count, my_rank+1) - my_first;
+   int *src = a, *dst = temp, *swap, *my_offsets, *wc;
+   int pass;
+   radix_plan_t plan;
+
+   Radix_min_max(a + my_first, my_n, &mins[my_rank], &maxs[my_rank]);
+   Barrier();
+   Radix_plan(mins, maxs, thread_count, &plan);
+   if (my_rank == 0)
+      hist = (int*) malloc(thread_count*plan.buckets*sizeof(int));
+   Barrier();
+
+   if (plan.passes == 0) {
+      Radix_histogram(&plan, 0, a + my_first, my_n,
+            hist + my_rank*plan.buckets);
+      Barrier();
+      Radix_fill(&plan, hist, thread_count, my_rank, a);
+      return NULL;
+   }
+
+   my_offsets = (int*) malloc(plan.buckets*sizeof(int));
+   wc = (int*) malloc(Radix_wc_size(&plan)*sizeof(int));
+   for (pass = 0; pass < plan.passes; pass++) {
+      Radix_histogram(&plan, pass, src + my_first, my_n,
+            hist + my_rank*plan.buckets);
+      Barrier();
+      Radix_offsets(hist, thread_count, plan.buckets, my_rank, my_offsets);
+      Radix_scatter(&plan, pass, src + my_first, my_n, my_offsets, wc, dst);
+      swap = src; src = dst; dst = swap;
+      Barrier();
+   }
+   if (src != a)
+      memcpy(a + my_first, src + my_first, my_n*sizeof(int));
+   free(my_offsets);
+   free(wc);
+   return NULL;
+}  /* Radix_sort */
+
+
+/*-----------------------------------------------------------------
+ * Function:    Merge_low
+ * Purpose:     Merge the smallest my_n elements of the sorted lists
+ *              my_keys and partner_keys into new_keys
+ * In args:     my_keys, my_n, partner_keys, partner_n
+ * Out args:    new_keys
+ */
+void Merge_low(
+      int  my_keys[]       /* in  */,
+      int  my_n            /* in  */,
+      int  partner_keys[]  /* in  */,
+      int  partner_n       /* in  */,
+      int  new_keys[]      /* out */) {
+   int m_i, p_i, n_i;
+
+   m_i = p_i = n_i = 0;
+   while (n_i < my_n) {
+      if (p_i >= partner_n || my_keys[m_i] <= partner_keys[p_i]) {
+         new_keys[n_i] = my_keys[m_i];
+         n_i++; m_i++;
+      } else {
+         new_keys[n_i] = partner_keys[p_i];
+         n_i++; p_i++;
+      }
+   }
+}  /* Merge_low */
+
+
+/*-----------------------------------------------------------------
+ * Function:    Merge_high
+ * Purpose:     Merge the largest my_n elements of the sorted lists
+ *              my_keys and partner_keys into new_keys
+ * In args:     my_keys, my_n, partner_keys, partner_n
+ * Out args:    new_keys
+ */
+void Merge_high(
+      int  my_keys[]       /* in  */,
+      int  my_n            /* in  */,
+      int  partner_keys[]  /* in  */,
+      int  partner_n       /* in  */,
+      int  new_keys[]      /* out */) {
+   int m_i, p_i, n_i;
+
+   m_i = my_n-1;
+   p_i = partner_n-1;
+   n_i = my_n-1;
+   while (n_i >= 0) {
+      if (p_i < 0 || my_keys[m_i] >= partner_keys[p_i]) {
+         new_keys[n_i] = my_keys[m_i];
+         n_i--; m_i--;
+      } else {
+         new_keys[n_i] = partner_keys[p_i];
+         n_i--; p_i--;
+      }
+   }
+}  /* Merge_high */
@@ -6,10 +6,13 @@
  * Output:  Estimate of integral from a to b of f(x)
  *          using n trapezoids.
  *
- * Compile: gcc -g -Wall -o trap trap.c
- * Usage:   ./trap n(n is the counts of the threads)
+ * Compile: gcc -g -Wall -o trap trap.c -lpthread -lm
+ * Usage:   ./trap n [options] (n is the counts of the threads)
+ *             options: see Common/trap_opts.h
  *
- * Note:    The function f(x) is hardwired.
+ * Note:    The integrand is chosen at run time from the registry in
+ *          Common/integrands.h; its inner loop is compiled with f
+ *          inlined.
  *
  * IPP:     Section 3.2.1 (pp. 94 and ff.) and 5.2 (p. 216)
  */
@@ -18,6 +21,15 @@
 #include <stdlib.h>
 #include <pthread.h>
 #include <Windows.h>
+#include "../Common/trap_opts.h"
+#include "../Common/adapt.h"
+#include "../Common/batch.h"
+#include "../Common/repro.h"
+#include "../Common/accum.h"
+#include "../Common/romberg.h"
+#include "../Common/cumul.h"
+#include "../Common/tabdata.h"
+#include "../Common/cache.h"
 
 #pragma comment(lib,"pthreadVC2.lib")
 
@@ -26,51 +38,240 @@ double a,b;         /* Left and right endpoints   */
 int     n;          /* Number of trapezoids       */
 double h;           /* Height of trapezoids       */
 double  sum;        /* Store result in sum   */
-pthread_mutex_t sum_mutex;              /* mutex of sum */
+accum_t acc;        /* Each thread's share of sum, one slot each */
+pthread_mutex_t count_mutex;            /* mutex of evals and next_job */
+const integrand_t* integrand;           /* Function we're integrating */
+const quad_rule_t* rule;                /* Panel rule, or NULL        */
 
-double f(double x);    /* Function we're integrating */
+/* Adaptive mode: a deque of tasks per thread and its mutex */
+typedef struct {
+   adapt_deque_t   deque;
+   pthread_mutex_t mutex;
+} adapt_slot_t;
+
+double tol;                 /* > 0:  adaptive Simpson to this error */
+adapt_slot_t* slots;
+int idle;                   /* Number of threads with no task       */
+pthread_mutex_t idle_mutex;
+long evals;                 /* Evaluations of f in adaptive mode    */
+
+/* Batch mode: the jobs, their results and the next job to hand out */
+batch_job_t* jobs;
+double* results;
+int job_count;
+int next_job;
+
+/* Reproducible mode: value of each leaf of repro.h */
+double* leaves;
+int leaf_count;
+
+/* Romberg mode: the points of the current level are
+ * level_x0 + i*level_step, 0 <= i < level_count */
+double level_x0, level_step;
+int level_count;
+
+/* Cubature mode: the 2D/3D integrand and its grid */
+const cub_integrand_t* cub;
+cub_grid_t grid;
+
+/* (Quasi-)Monte Carlo mode: the d-dimensional integrand, its sample
+ * generator, the number of samples and each thread's sum of f^2 */
+const qmc_integrand_t* qmc;
+qmc_gen_t qmc_gen;
+long long qmc_samples;
+accum_t acc_sq;
+
+/* Cumulative mode: every k-th grid point is an output point; each
+ * thread's block of F values and its total, and the records */
+int every;
+int cumul_points;
+double* cumul_values;
+double* cumul_totals;
+char* cumul_buf;
+
+/* Tabulated mode: a mapping of the whole file of samples */
+tab_map_t tab_map;
+
+/* Cached mode: the blocks of the lattice needed and which are missing */
+cache_plan_t cache_plan;
+
+void Usage(char* prog_name);
 void* Trap(void* rank);
+void* Rule_trap(void* rank);
+void* Adapt_trap(void* rank);
+void Adapt_push(void* slot, const adapt_task_t* task_p);
+int Adapt_take(long my_rank, adapt_task_t* task_p);
+void* Batch_worker(void* rank);
+void* Repro_trap(void* rank);
+void Run_threads(pthread_t thread_handles[], void* (*thread_fn)(void*));
+void Romberg_trap(romberg_t* r_p, pthread_t thread_handles[]);
+void* Level_sum(void* rank);
+int Run_cubature(pthread_t thread_handles[]);
+void* Cub_trap(void* rank);
+int Run_qmc(pthread_t thread_handles[], const trap_opts_t* opts_p);
+void* Qmc_trap(void* rank);
+int Run_cumul(pthread_t thread_handles[], const char* fname);
+void* Cumul_local(void* rank);
+void* Cumul_offset(void* rank);
+int Run_tab(pthread_t thread_handles[], const char* fname);
+void* Tab_worker(void* rank);
+int Run_cached(pthread_t thread_handles[], const char* fname);
+void* Cache_worker(void* rank);
 
 int main(int argc,char* argv[]) {
    int i;
    pthread_t* thread_handles = NULL;
+   void* (*thread_fn)(void*) = Trap;
    double beg,end;
+   trap_opts_t opts;
+   int status;
+   romberg_t romberg;
 
+   if (argc < 2) Usage(argv[0]);
    thread_count = strtol(argv[1],NULL,10);
+   status = Get_trap_opts(argc, argv, 2, &opts, 1);
+   if (status > 0) return 0;
+   if (status < 0) return 1;   /* Get_trap_opts has said what was wrong */
+   if (thread_count < 1) Usage(argv[0]);
+   integrand = opts.integrand;
+   rule = opts.rule;
+   tol = opts.tol;
+   cub = opts.cub;
+   qmc = opts.qmc;
 
-   printf("Enter a, b, and n\n");
-   scanf("%lf", &a);
-   scanf("%lf", &b);
-   scanf("%d", &n);
+   if (opts.batch != NULL) {
+      if (Read_batch(opts.batch, &jobs, &job_count) != 0) return 1;
+      results = (double*)malloc(job_count*sizeof(double));
+      next_job = 0;
+      thread_fn = Batch_worker;
+   } else if (cub == NULL && qmc == NULL && opts.tab == NULL) {
+      printf("Enter a, b, and n\n");
+      scanf("%lf", &a);
+      scanf("%lf", &b);
+      scanf("%d", &n);
+   }
 
    h = (b-a)/n;
    sum = 0;
+   Accum_init(&acc, thread_count);
    thread_handles = (pthread_t*)malloc(thread_count*sizeof(pthread_t));
-   pthread_mutex_init(&sum_mutex,NULL);
+   pthread_mutex_init(&count_mutex,NULL);
+   if (opts.batch == NULL && (cub != NULL || qmc != NULL
+         || opts.tab != NULL || opts.cumul != NULL)) {
+      if (cub != NULL)
+         status = Run_cubature(thread_handles);
+      else if (qmc != NULL)
+         status = Run_qmc(thread_handles, &opts);
+      else if (opts.tab != NULL)
+         status = Run_tab(thread_handles, opts.tab);
+      else {
+         every = opts.every;
+         status = Run_cumul(thread_handles, opts.cumul);
+      }
+      pthread_mutex_destroy(&count_mutex);
+      Accum_free(&acc);
+      free(thread_handles);
+      return status;
+   } else if (opts.batch == NULL && opts.cache != NULL && tol <= 0.0
+         && opts.romberg <= 0 && !opts.repro) {
+      status = Run_cached(thread_handles, opts.cache);
+      pthread_mutex_destroy(&count_mutex);
+      Accum_free(&acc);
+      free(thread_handles);
+      return status;
+   } else if (opts.batch == NULL && tol > 0.0) {
+      if (n < 1) n = thread_count;
+      thread_fn = Adapt_trap;
+      slots = (adapt_slot_t*)malloc(thread_count*sizeof(adapt_slot_t));
+      for (i = 0; i < thread_count; i++) {
+         Adapt_deque_init(&slots[i].deque);
+         pthread_mutex_init(&slots[i].mutex, NULL);
+      }
+      idle = 0;
+      evals = 0;
+      pthread_mutex_init(&idle_mutex, NULL);
+   } else if (opts.batch == NULL && opts.repro) {
+      thread_fn = Repro_trap;
+      leaf_count = Repro_leaf_count(n);
+      leaves = (double*)malloc(leaf_count*sizeof(double));
+   } else if (opts.batch == NULL && opts.romberg <= 0 && rule != NULL) {
+      thread_fn = Rule_trap;
+   }
 
    beg = GetTickCount();
-   for(i=0;i<thread_count;i++)
-	   pthread_create(&thread_handles[i],NULL,Trap,(void*)i);
-
-   for(i=0;i<thread_count;i++)
-	   pthread_join(thread_handles[i],NULL);
+   if (opts.batch == NULL && tol <= 0.0 && opts.romberg > 0) {
+      Romberg_init(&romberg, a, b, n, opts.romberg);
+      Romberg_trap(&romberg, thread_handles);
+      sum = romberg.R[romberg.level][romberg.level];
+   } else {
+      Run_threads(thread_handles, thread_fn);
+   }
+   if (thread_fn == Repro_trap) {
+      sum = Pairwise_sum(leaves, leaf_count);
+      free(leaves);
+   } else if (opts.batch != NULL || tol > 0.0 || opts.romberg <= 0) {
+      sum = Accum_combine(&acc);
+   }
    end = GetTickCount();
    
-   pthread_mutex_destroy(&sum_mutex);
-   printf("With n = %d trapezoids, our estimate\n", n);
-   printf("of the integral from %f to %f = %.15f\n",
-      a, b, sum);
+   pthread_mutex_destroy(&count_mutex);
+   Accum_free(&acc);
+   if (opts.batch != NULL) {
+      Print_batch(jobs, results, job_count);
+      printf("\n%d jobs, time: %fs\n", job_count, (end-beg)/1000);
+      free(jobs);
+      free(results);
+      free(thread_handles);
+      return 0;
+   } else if (tol > 0.0) {
+      for (i = 0; i < thread_count; i++) {
+         Adapt_deque_free(&slots[i].deque);
+         pthread_mutex_destroy(&slots[i].mutex);
+      }
+      free(slots);
+      pthread_mutex_destroy(&idle_mutex);
+      printf("With adaptive Simpson, tol = %e, %ld evaluations of f,\n",
+         tol, evals);
+      printf("our estimate\n");
+   } else if (opts.romberg > 0) {
+      Romberg_print(&romberg, stdout);
+      printf("\nWith Romberg extrapolation from n = %d to %d trapezoids,\n",
+         n, n << romberg.level);
+      printf("our estimate\n");
+   } else if (opts.repro) {
+      printf("With n = %d trapezoids (%s kernel, reproducible sum),\n",
+         n, trap_isa_names[opts.isa]);
+      printf("our estimate\n");
+   } else if (thread_fn == Rule_trap) {
+      printf("With n = %d %s panels (%s kernel), our estimate\n",
+         n, rule->name, trap_isa_names[opts.isa]);
+   } else {
+      printf("With n = %d trapezoids (%s kernel), our estimate\n",
+         n, trap_isa_names[opts.isa]);
+   }
+   printf("of the integral of %s from %f to %f = %.15f\n",
+      integrand->formula, a, b, sum);
    printf("\nTime: %fs\n",(end-beg)/1000);
 
    return 0;
 }  /* main */
 
+/*------------------------------------------------------------------
+ * Function:  Usage
+ * Purpose:   Summary of how to run program
+ */
+void Usage(char* prog_name) {
+   fprintf(stderr, "usage: %s <thread_count> [options]\n", prog_name);
+   Trap_opts_usage();
+   exit(1);
+}  /* Usage */
+
 /*------------------------------------------------------------------
  * Function:    Trap
  * Purpose:     Estimate integral from a to b of f using trap rule and
  *              n trapezoids
  * Input args:  a, b, n, h
- * Return val:  Estimate of the integral 
+ * Globals:     adds this thread's estimate to its slot of acc
  */
 void* Trap(void* rank) {
 	long my_rank = (long)rank;
@@ -82,29 +283,492 @@ void* Trap(void* rank) {
 		local_b = n;
 
 	double integral;
-	int k;
 
-	integral = (f(local_a) + f(local_b))/2.0;
-	for (k = 1; k <= local_n-1; k++) {
-		integral += f(local_a+k*h);
-	}
+	integral = (integrand->f(local_a) + integrand->f(local_b))/2.0;
+	integral += integrand->sum(local_a, h, 1, (int)local_n-1);
 	integral = integral*h;
 
-	pthread_mutex_lock(&sum_mutex);
-	sum+=integral;
-	pthread_mutex_unlock(&sum_mutex);
+	Accum_add(&acc, my_rank, integral);
 
 	return NULL;
 }  /* Trap */
 
 /*------------------------------------------------------------------
- * Function:    f
- * Purpose:     Compute value of function to be integrated
- * Input args:  x
+ * Function:    Rule_trap
+ * Purpose:     Apply rule to this thread's block of the n panels of
+ *              width h
+ * Input args:  rank
+ * Globals:     a, n, h, rule, integrand; adds this thread's estimate
+ *              to its slot of acc
+ */
+void* Rule_trap(void* rank) {
+   long my_rank = (long)rank;
+
+   Accum_add(&acc, my_rank, Rule_sum(rule, integrand, a, h,
+         Repro_first(n, thread_count, my_rank),
+         Repro_first(n, thread_count, my_rank+1)));
+
+   return NULL;
+}  /* Rule_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_trap
+ * Purpose:     Adaptive Simpson's rule with work stealing.  Each
+ *              thread starts from every thread_count-th of the n
+ *              panels, refines depth first, and when its own deque
+ *              runs dry steals the oldest task from another thread.
+ *              The threads stop when all of them are idle.
+ * Input args:  rank
+ * Globals:     a, b, n, tol, integrand, slots, idle; adds to acc and
+ *              evals
+ */
+void* Adapt_trap(void* rank) {
+   long my_rank = (long)rank;
+   adapt_task_t task;
+   double integral = 0.0;
+   long my_evals = 0;
+   int i, size, my_idle, done = 0;
+
+   for (i = my_rank; i < n; i += thread_count) {
+      Adapt_first_task(integrand, a, b, n, i, tol, &task, &my_evals);
+      Adapt_push(&slots[my_rank], &task);
+   }
+
+   while (!done) {
+      if (Adapt_take(my_rank, &task)) {
+         integral += Adapt_run(integrand, task, Adapt_push,
+               &slots[my_rank], &my_evals);
+         continue;
+      }
+
+      /* Idle threads hold no tasks, so once every thread is idle
+       * there is nothing left anywhere */
+      pthread_mutex_lock(&idle_mutex);
+      my_idle = ++idle;
+      pthread_mutex_unlock(&idle_mutex);
+      while (my_idle < thread_count) {
+         for (i = 0; i < thread_count; i++) {
+            pthread_mutex_lock(&slots[i].mutex);
+            size = Adapt_deque_size(&slots[i].deque);
+            pthread_mutex_unlock(&slots[i].mutex);
+            if (size > 0) break;
+         }
+         pthread_mutex_lock(&idle_mutex);
+         if (i < thread_count) idle--;
+         my_idle = idle;
+         pthread_mutex_unlock(&idle_mutex);
+         if (i < thread_count) break;
+      }
+      done = my_idle == thread_count;
+   }
+
+   Accum_add(&acc, my_rank, integral);
+   pthread_mutex_lock(&count_mutex);
+   evals += my_evals;
+   pthread_mutex_unlock(&count_mutex);
+
+   return NULL;
+}  /* Adapt_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_push
+ * Purpose:     Put a task on the bottom of a thread's deque
+ */
+void Adapt_push(void* slot, const adapt_task_t* task_p) {
+   adapt_slot_t* slot_p = (adapt_slot_t*) slot;
+
+   pthread_mutex_lock(&slot_p->mutex);
+   Adapt_deque_push(&slot_p->deque, task_p);
+   pthread_mutex_unlock(&slot_p->mutex);
+}  /* Adapt_push */
+
+/*------------------------------------------------------------------
+ * Function:    Adapt_take
+ * Purpose:     Pop the newest task from my deque, or failing that
+ *              steal the oldest task from the next thread that has one
+ * Return val:  1 if a task was found
+ */
+int Adapt_take(long my_rank, adapt_task_t* task_p) {
+   int i, victim, found;
+
+   for (i = 0; i < thread_count; i++) {
+      victim = (my_rank + i) % thread_count;
+      pthread_mutex_lock(&slots[victim].mutex);
+      if (i == 0)
+         found = Adapt_deque_pop(&slots[victim].deque, task_p);
+      else
+         found = Adapt_deque_steal(&slots[victim].deque, task_p);
+      pthread_mutex_unlock(&slots[victim].mutex);
+      if (found) return 1;
+   }
+   return 0;
+}  /* Adapt_take */
+
+/*------------------------------------------------------------------
+ * Function:    Batch_worker
+ * Purpose:     Take jobs one at a time until there are none left,
+ *              computing each with the serial trapezoidal rule
+ * Input args:  rank
+ * Globals:     jobs, job_count, next_job; sets results
+ */
+void* Batch_worker(void* rank) {
+   int job;
+
+   (void) rank;   /* jobs are handed out in order, not by rank */
+   for (;;) {
+      pthread_mutex_lock(&count_mutex);
+      job = next_job++;
+      pthread_mutex_unlock(&count_mutex);
+      if (job >= job_count) break;
+      results[job] = Batch_trap(&jobs[job]);
+   }
+
+   return NULL;
+}  /* Batch_worker */
+
+/*------------------------------------------------------------------
+ * Function:    Repro_trap
+ * Purpose:     Compute this thread's share of the leaves of repro.h.
+ *              main adds them up in a fixed order, so the result
+ *              doesn't depend on thread_count.
+ * Input args:  rank
+ * Globals:     a, n, h, integrand, leaf_count; sets leaves
+ */
+void* Repro_trap(void* rank) {
+   long my_rank = (long)rank;
+   int j;
+   int first = Repro_first(leaf_count, thread_count, my_rank);
+   int last = Repro_first(leaf_count, thread_count, my_rank+1);
+
+   for (j = first; j < last; j++)
+      leaves[j] = Repro_leaf(integrand, a, h, n, leaf_count, j);
+
+   return NULL;
+}  /* Repro_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Run_threads
+ * Purpose:     Start thread_count threads running thread_fn and wait
+ *              for all of them to finish
+ */
+void Run_threads(pthread_t thread_handles[], void* (*thread_fn)(void*)) {
+   long i;
+
+   for (i = 0; i < thread_count; i++)
+      pthread_create(&thread_handles[i], NULL, thread_fn, (void*) i);
+   for (i = 0; i < thread_count; i++)
+      pthread_join(thread_handles[i], NULL);
+}  /* Run_threads */
+
+/*------------------------------------------------------------------
+ * Function:    Romberg_trap
+ * Purpose:     Fill in a Romberg table.  Each level evaluates only
+ *              the midpoints of the previous level's trapezoids, in
+ *              parallel by Level_sum.
+ * In/out args: r_p:  initialized by Romberg_init
+ * Globals:     sets level_x0, level_step, level_count; uses acc
+ */
+void Romberg_trap(romberg_t* r_p, pthread_t thread_handles[]) {
+   double s0 = (integrand->f(r_p->a) + integrand->f(r_p->b))/2.0;
+
+   level_x0 = r_p->a + (r_p->b - r_p->a)/r_p->n;
+   level_step = (r_p->b - r_p->a)/r_p->n;
+   level_count = r_p->n - 1;
+   do {
+      Accum_reset(&acc);
+      Run_threads(thread_handles, Level_sum);
+      Romberg_add(r_p, s0 + Accum_combine(&acc));
+      s0 = 0.0;
+   } while (Romberg_next(r_p, &level_x0, &level_step, &level_count));
+}  /* Romberg_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Level_sum
+ * Purpose:     Add f over this thread's block of the current Romberg
+ *              level's points to its slot of acc
+ * Input args:  rank
+ * Globals:     level_x0, level_step, level_count, integrand
+ */
+void* Level_sum(void* rank) {
+   long my_rank = (long)rank;
+   int first = Repro_first(level_count, thread_count, my_rank);
+   int last = Repro_first(level_count, thread_count, my_rank+1);
+
+   Accum_add(&acc, my_rank, integrand->sum(level_x0, level_step,
+         first, last-1));
+
+   return NULL;
+}  /* Level_sum */
+
+/*------------------------------------------------------------------
+ * Function:    Run_cubature
+ * Purpose:     Read a box and n, and integrate the 2D or 3D integrand
+ *              cub over it with thread_count threads
+ * Globals:     sets grid; uses cub, acc
+ * Return val:  0 on success, 1 on bad input
+ */
+int Run_cubature(pthread_t thread_handles[]) {
+   double a[3], b[3];
+   int n[3];
+   double result, beg, end;
+
+   if (Read_cub_box(cub->dims, a, b, n) != 0) return 1;
+   Cub_grid_init(&grid, cub->dims, a, b, n);
+
+   beg = GetTickCount();
+   Run_threads(thread_handles, Cub_trap);
+   result = Accum_combine(&acc)*Cub_cell_volume(&grid);
+   end = GetTickCount();
+
+   Print_cub_result(cub, &grid, result);
+   printf("\nTime: %fs\n", (end-beg)/1000);
+   return 0;
+}  /* Run_cubature */
+
+/*------------------------------------------------------------------
+ * Function:    Cub_trap
+ * Purpose:     Add up every thread_count-th tile of the grid, starting
+ *              at tile rank, into this thread's slot of acc
+ * Input args:  rank
+ * Globals:     cub, grid, acc
+ */
+void* Cub_trap(void* rank) {
+   long my_rank = (long)rank;
+   long tile, tile_count = Cub_tile_count(&grid);
+
+   for (tile = my_rank; tile < tile_count; tile += thread_count)
+      Accum_add(&acc, my_rank, Cub_tile(cub, &grid, tile));
+
+   return NULL;
+}  /* Cub_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Run_qmc
+ * Purpose:     Read d, a, b and the number of samples, and integrate
+ *              the d-dimensional integrand qmc over [a, b]^d with
+ *              thread_count threads
+ * Globals:     sets qmc_gen, qmc_samples, acc_sq; uses qmc, acc
+ * Return val:  0 on success, 1 on bad input
+ */
+int Run_qmc(pthread_t thread_handles[], const trap_opts_t* opts_p) {
+   int dims;
+   double a, b, sum, sumsq, beg, end;
+
+   if (Read_qmc_input(opts_p->seq, &dims, &a, &b,
+         &qmc_samples) != 0) return 1;
+   Qmc_init(&qmc_gen, opts_p->seq, dims, a, b, opts_p->seed);
+   Accum_init(&acc_sq, thread_count);
+
+   beg = GetTickCount();
+   Run_threads(thread_handles, Qmc_trap);
+   sum = Accum_combine(&acc);
+   sumsq = Accum_combine(&acc_sq);
+   end = GetTickCount();
+
+   Print_qmc_result(qmc, &qmc_gen, qmc_samples, sum, sumsq);
+   printf("\nTime: %fs\n", (end-beg)/1000);
+   Accum_free(&acc_sq);
+   return 0;
+}  /* Run_qmc */
+
+/*------------------------------------------------------------------
+ * Function:    Qmc_trap
+ * Purpose:     Make and evaluate this thread's block of the samples,
+ *              adding f to its slot of acc and f^2 to its slot of
+ *              acc_sq
+ * Input args:  rank
+ * Globals:     qmc, qmc_gen, qmc_samples, acc, acc_sq
+ */
+void* Qmc_trap(void* rank) {
+   long my_rank = (long)rank;
+   double my_sum = 0.0, my_sumsq = 0.0;
+
+   Qmc_sum(qmc, &qmc_gen, Repro_first(qmc_samples, thread_count, my_rank),
+         Repro_first(qmc_samples, thread_count, my_rank+1),
+         &my_sum, &my_sumsq);
+   Accum_add(&acc, my_rank, my_sum);
+   Accum_add(&acc_sq, my_rank, my_sumsq);
+
+   return NULL;
+}  /* Qmc_trap */
+
+/*------------------------------------------------------------------
+ * Function:    Run_cumul
+ * Purpose:     Write the cumulative integral at every k-th grid point
+ *              to fname, by a two pass scan (see cumul.h).  The join
+ *              after the first pass is the barrier between them.
+ * Globals:     sets cumul_points, cumul_values, cumul_totals,
+ *              cumul_buf; uses a, b, n, h, every, integrand
+ * Return val:  0 on success, 1 on bad input or if the file can't be
+ *              written
+ */
+int Run_cumul(pthread_t thread_handles[], const char* fname) {
+   double total, beg, end;
+   FILE* fp;
+   int i, error;
+
+   if (n < 1) return 1;
+   fp = fopen(fname, "wb");
+   if (fp == NULL) {
+      fprintf(stderr, "Can't open %s\n", fname);
+      return 1;
+   }
+   cumul_points = Cumul_point_count(n, every);
+   cumul_values = (double*)malloc(cumul_points*sizeof(double));
+   cumul_totals = (double*)malloc(thread_count*sizeof(double));
+   cumul_buf = (char*)malloc((size_t)cumul_points*CUMUL_RECORD);
+
+   beg = GetTickCount();
+   Run_threads(thread_handles, Cumul_local);
+   Run_threads(thread_handles, Cumul_offset);
+   total = Cumul_tail(integrand, a, h, n, every);
+   for (i = 0; i < thread_count; i++)
+      total += cumul_totals[i];
+   error = fwrite(cumul_buf, CUMUL_RECORD, cumul_points, fp)
+      != (size_t)cumul_points;
+   error |= fclose(fp) != 0;
+   end = GetTickCount();
+
+   if (error)
+      fprintf(stderr, "Error writing %s\n", fname);
+   else
+      Print_cumul_result(integrand, a, b, n, every, fname, total);
+   printf("\nTime: %fs\n", (end-beg)/1000);
+
+   free(cumul_values);
+   free(cumul_totals);
+   free(cumul_buf);
+   return error;
+}  /* Run_cumul */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_local
+ * Purpose:     Pass 1: prefix sums of this thread's block of output
+ *              points, and the block's total
+ * Input args:  rank
+ * Globals:     cumul_values, cumul_totals (this thread's part)
  */
-double f(double x) {
-   double return_val;
+void* Cumul_local(void* rank) {
+   long my_rank = (long)rank;
+   int j0 = Repro_first(cumul_points, thread_count, my_rank);
+   int j1 = Repro_first(cumul_points, thread_count, my_rank+1);
+
+   cumul_totals[my_rank] = Cumul_prefix(integrand, a, h, every, j0, j1,
+         cumul_values + j0);
+
+   return NULL;
+}  /* Cumul_local */
+
+/*------------------------------------------------------------------
+ * Function:    Cumul_offset
+ * Purpose:     Pass 2: add the totals of the blocks before this
+ *              thread's to its values, and format its records
+ * Input args:  rank
+ * Globals:     cumul_buf (this thread's part)
+ */
+void* Cumul_offset(void* rank) {
+   long my_rank = (long)rank;
+   int j0 = Repro_first(cumul_points, thread_count, my_rank);
+   int j1 = Repro_first(cumul_points, thread_count, my_rank+1);
+   double offset = 0.0;
+   long t;
+
+   for (t = 0; t < my_rank; t++)
+      offset += cumul_totals[t];
+   Cumul_format(cumul_buf + (size_t)j0*CUMUL_RECORD, a, h, every, j0,
+         j1 - j0, cumul_values + j0, offset);
+
+   return NULL;
+}  /* Cumul_offset */
+
+/*------------------------------------------------------------------
+ * Function:    Run_tab
+ * Purpose:     Integrate the (x, y) samples in the file fname.  The
+ *              file is mapped once, and each thread integrates its
+ *              block of the intervals where it lies in the mapping.
+ * Globals:     sets tab_map; uses acc
+ * Return val:  0 on success, 1 if the file can't be read
+ */
+int Run_tab(pthread_t thread_handles[], const char* fname) {
+   long long samples;
+   double total, beg, end;
+
+   samples = Tab_samples(fname);
+   if (samples < 0) return 1;
+   beg = GetTickCount();
+   if (Tab_map(fname, 0, samples, &tab_map) != 0) return 1;
+   Run_threads(thread_handles, Tab_worker);
+   total = Accum_combine(&acc);
+   end = GetTickCount();
+
+   Print_tab_result(fname, samples, tab_map.xy[0],
+         tab_map.xy[2*samples-2], total);
+   printf("\nTime: %fs\n", (end-beg)/1000);
+   Tab_unmap(&tab_map);
+   return 0;
+}  /* Run_tab */
+
+/*------------------------------------------------------------------
+ * Function:    Tab_worker
+ * Purpose:     Integrate this thread's block of the intervals between
+ *              the samples, adding it to its slot of acc
+ * Input args:  rank
+ * Globals:     tab_map, acc
+ */
+void* Tab_worker(void* rank) {
+   long my_rank = (long)rank;
+   long long intervals = tab_map.count - 1;
+   long long i0 = Repro_first(intervals, thread_count, my_rank);
+   long long i1 = Repro_first(intervals, thread_count, my_rank+1);
+
+   /* Intervals i0, ..., i1-1 need samples i0, ..., i1 */
+   Accum_add(&acc, my_rank, Tab_trap(tab_map.xy + 2*i0, i1 - i0 + 1));
+
+   return NULL;
+}  /* Tab_worker */
+
+/*------------------------------------------------------------------
+ * Function:    Run_cached
+ * Purpose:     Trapezoidal rule (or -rule) using the cache in fname:
+ *              the threads compute only the blocks of the lattice that
+ *              aren't cached yet (see cache.h)
+ * Globals:     sets cache_plan; uses a, b, n, integrand, rule
+ * Return val:  0 on success, 1 on bad input or if the cache can't be
+ *              read or written
+ */
+int Run_cached(pthread_t thread_handles[], const char* fname) {
+   cache_t cache;
+   double beg, end;
+
+   if (n < 1) return 1;
+   if (Cache_open(&cache, fname) != 0) return 1;
+
+   beg = GetTickCount();
+   Cache_plan(&cache_plan, &cache, integrand, rule, a, b, n);
+   if (!cache_plan.hit) {
+      Run_threads(thread_handles, Cache_worker);
+      Cache_finish(&cache_plan, &cache);
+   }
+   end = GetTickCount();
+
+   Print_cache_result(&cache_plan);
+   printf("\nTime: %fs\n", (end-beg)/1000);
+   Cache_plan_free(&cache_plan);
+   return Cache_close(&cache) != 0;
+}  /* Run_cached */
+
+/*------------------------------------------------------------------
+ * Function:    Cache_worker
+ * Purpose:     Compute this thread's share of the missing blocks
+ * Input args:  rank
+ * Globals:     cache_plan
+ */
+void* Cache_worker(void* rank) {
+   long my_rank = (long)rank;
+   int count = cache_plan.missing_count;
+
+   Cache_fill(&cache_plan, Repro_first(count, thread_count, my_rank),
+         Repro_first(count, thread_count, my_rank+1));
 
-   return_val = x*x;
-   return return_val;
-}  /* f */
+   return NULL;
+}  /* Cache_worker */